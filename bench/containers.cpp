@@ -0,0 +1,106 @@
+#include "tiny-resource.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Measures node-based containers filled, churned and emptied with
+// `std::allocator` and with `tiny::allocator` on a heap of their own.
+//
+// Usage:
+//     bench-containers [NODES [ROUNDS]]
+
+static double now() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+template<typename Allocator>
+using list = std::list<long, Allocator>;
+
+template<typename Allocator>
+using map = std::map<long, long, std::less<long>, Allocator>;
+
+template<typename Allocator>
+using unordered_map = std::unordered_map<long, long, std::hash<long>, std::equal_to<long>, Allocator>;
+
+// Inserts every key, erases and reinserts every other one, then empties the
+// container, once per round. Returns a value that depends on the contents so
+// that the work is not optimised away.
+template<typename Container, typename Allocator>
+static long churn(const std::vector<long> &keys, unsigned rounds, const Allocator &allocator) {
+    long checksum = 0;
+    for(unsigned round = 0; round < rounds; round++) {
+        Container container(allocator);
+        for(long key : keys) {
+            if constexpr(std::is_same_v<typename Container::value_type, long>) {
+                container.push_back(key);
+            } else {
+                container.emplace(key, round);
+            }
+        }
+        if constexpr(std::is_same_v<typename Container::value_type, long>) {
+            for(auto it = container.begin(); it != container.end(); it = container.erase(it), ++it) {}
+            for(size_t i = 0; i < keys.size(); i += 2) {
+                container.push_front(keys[i]);
+            }
+        } else {
+            for(size_t i = 0; i < keys.size(); i += 2) {
+                container.erase(keys[i]);
+            }
+            for(size_t i = 0; i < keys.size(); i += 2) {
+                container.emplace(keys[i], round);
+            }
+        }
+        checksum += container.size();
+    }
+    return checksum;
+}
+
+template<template<typename> class Container, typename T>
+static void run(const char *name, const std::vector<long> &keys, unsigned rounds, tiny::heap_resource &resource) {
+    double start = now();
+    long checksum = churn<Container<std::allocator<T>>>(keys, rounds, std::allocator<T>());
+    double standard = now() - start;
+
+    start = now();
+    checksum -= churn<Container<tiny::allocator<T>>>(keys, rounds, tiny::allocator<T>(resource));
+    double tiny = now() - start;
+
+    if(checksum != 0) {
+        std::printf("%-16s results differ\n", name);
+        std::exit(EXIT_FAILURE);
+    }
+    std::printf(
+        "%-16s std::allocator %8.2f ms, tiny::allocator %8.2f ms (%.2fx)\n",
+        name, standard * 1e3, tiny * 1e3, standard / tiny
+    );
+}
+
+int main(int argc, char *argv[]) {
+    size_t nodes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+    unsigned rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+
+    std::vector<long> keys(nodes);
+    for(size_t i = 0; i < nodes; i++) {
+        keys[i] = static_cast<long>(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+
+    // Large enough for the biggest container, buckets included
+    size_t heap_size = nodes * 128 + (1 << 20);
+    void *buffer = std::malloc(heap_size);
+    {
+        tiny::heap_resource resource(buffer, heap_size);
+        run<list, long>("list", keys, rounds, resource);
+        run<map, std::pair<const long, long>>("map", keys, rounds, resource);
+        run<unordered_map, std::pair<const long, long>>("unordered_map", keys, rounds, resource);
+    }
+    std::free(buffer);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include "tiny-frames.hpp"
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <vector>
+
+// Measures coroutine frame allocation with the global `operator new`, with
+// `tiny_malloc()` and with `tiny::frame_allocated`. Each request is served by
+// a coroutine awaiting two others, and a number of requests are in flight at
+// once, so that frames of three sizes come and go interleaved.
+//
+// Usage:
+//     bench-coroutines [REQUESTS [IN_FLIGHT]]
+
+static double now() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+// Allocates frames with the global `operator new`
+struct global_frames {};
+
+// Allocates frames from the main heap, walking it every time
+struct heap_frames {
+    static void *operator new(std::size_t size) {
+        void *ptr = tiny_malloc(size);
+        if(ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+    static void operator delete(void *ptr) noexcept {
+        tiny_free(ptr);
+    }
+};
+
+// A lazily started coroutine that resumes the one awaiting it when done
+template<typename Frames>
+class task {
+public:
+    struct promise_type : Frames {
+        task get_return_object() noexcept {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        struct final_awaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                std::coroutine_handle<> continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_value(long value) noexcept {
+            result = value;
+        }
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+
+        long result = 0;
+        std::coroutine_handle<> continuation;
+    };
+
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : handle(handle) {}
+    task(task &&other) noexcept : handle(other.handle) {
+        other.handle = nullptr;
+    }
+    task(const task &) = delete;
+    ~task() {
+        if(handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle.promise().continuation = continuation;
+        return handle;
+    }
+
+    long await_resume() noexcept {
+        return handle.promise().result;
+    }
+
+    long run() {
+        handle.resume();
+        return handle.promise().result;
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template<typename Frames>
+static task<Frames> parse(long id) {
+    volatile char header[64];
+    header[id % sizeof(header)] = static_cast<char>(id);
+    co_return header[id % sizeof(header)] + 1;
+}
+
+template<typename Frames>
+static task<Frames> respond(long id) {
+    volatile char body[448];
+    body[id % sizeof(body)] = static_cast<char>(id);
+    co_return body[id % sizeof(body)] * 2;
+}
+
+template<typename Frames>
+static task<Frames> serve(long id) {
+    long request = co_await parse<Frames>(id);
+    long response = co_await respond<Frames>(id + request);
+    co_return request + response;
+}
+
+template<typename Frames>
+static long run(const char *name, size_t requests, size_t in_flight, double *reference) {
+    std::vector<task<Frames>> tasks;
+    tasks.reserve(in_flight);
+    long checksum = 0;
+    double start = now();
+    for(size_t served = 0; served < requests; served += in_flight) {
+        for(size_t i = 0; i < in_flight; i++) {
+            tasks.push_back(serve<Frames>(static_cast<long>(served + i)));
+        }
+        for(task<Frames> &request : tasks) {
+            checksum += request.run();
+        }
+        tasks.clear();
+    }
+    double elapsed = now() - start;
+    if(*reference == 0) {
+        *reference = elapsed;
+    }
+    std::printf(
+        "%-16s %8.2f ms, %7.1f ns per frame (%.2fx)\n",
+        name, elapsed * 1e3, elapsed * 1e9 / (3 * requests), *reference / elapsed
+    );
+    return checksum;
+}
+
+int main(int argc, char *argv[]) {
+    size_t requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t in_flight = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    if(in_flight == 0) {
+        return EXIT_FAILURE;
+    }
+
+    static unsigned char buffer[16 << 20];
+    tiny_init(buffer, sizeof(buffer));
+    double reference = 0;
+    long checksum = run<global_frames>("operator new", requests, in_flight, &reference);
+    if(
+        run<heap_frames>("tiny_malloc", requests, in_flight, &reference) != checksum ||
+        run<tiny::frame_allocated<>>("frame_allocated", requests, in_flight, &reference) != checksum
+    ) {
+        std::printf("results differ\n");
+        return EXIT_FAILURE;
+    }
+    tiny::frame_pool::local().release();
+    return EXIT_SUCCESS;
+}
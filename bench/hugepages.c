@@ -0,0 +1,60 @@
+#define _POSIX_C_SOURCE 200809L
+#include "tiny.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures how fast the section chain is walked when the heap is backed by
+// regular pages, transparent huge pages and huge pages from the system pool.
+//
+// Usage:
+//     bench-hugepages [HEAP_MIB [STRIDE [ROUNDS]]]
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static void run(const char *name, unsigned flags, size_t heap_size, size_t stride, unsigned rounds) {
+    if(!tiny_init_mapped(heap_size, flags)) {
+        printf("%-12s could not map %zu bytes\n", name, heap_size);
+        return;
+    }
+
+    // Fills the heap with sections one stride apart, so that every header
+    // is on a different regular page
+    size_t sections = 0;
+    double start = now();
+    while(tiny_malloc(stride - tiny_block_size()) != NULL) {
+        sections++;
+    }
+    double fill = now() - start;
+
+    // Allocations that do not fit visit every section
+    start = now();
+    for(unsigned round = 0; round < rounds; round++) {
+        if(tiny_malloc(heap_size) != NULL) {
+            abort();
+        }
+    }
+    double scan = now() - start;
+
+    printf(
+        "%-12s page size %8zu: %zu sections, fill %.2f s, %.2f ns per section scanned\n",
+        name, tiny_inspect().page_size, sections, fill,
+        scan * 1e9 / ((double)sections * rounds)
+    );
+    tiny_clear();
+}
+
+int main(int argc, char *argv[]) {
+    size_t heap_size = (argc > 1 ? strtoull(argv[1], NULL, 10) : 64) << 20;
+    size_t stride = argc > 2 ? strtoull(argv[2], NULL, 10) : 8192;
+    unsigned rounds = argc > 3 ? strtoul(argv[3], NULL, 10) : 200;
+
+    run("regular", 0, heap_size, stride, rounds);
+    run("thp", TINY_MAP_HUGEPAGE, heap_size, stride, rounds);
+    run("hugetlb", TINY_MAP_HUGETLB, heap_size, stride, rounds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+#define _POSIX_C_SOURCE 200809L
+#ifdef TINY_SINGLE
+#define TINY_IMPLEMENTATION
+#include "tiny-single.h"
+#else
+#include "tiny.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures small allocations of constant sizes, taken and freed in short
+// bursts. Built once against `libtiny.so` and once with the single header
+// and TINY_SINGLE defined, where they take the inline path.
+//
+// Usage:
+//     bench-shared [ROUNDS]
+//     bench-single [ROUNDS]
+
+enum { BURST = 8 };
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    size_t rounds = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+    static unsigned char buffer[1 << 16];
+    tiny_init(buffer, sizeof(buffer));
+
+    void *objects[2 * BURST];
+    double start = now();
+    for(size_t round = 0; round < rounds; round++) {
+        for(size_t i = 0; i < BURST; i++) {
+            objects[2 * i] = tiny_malloc(24);
+            objects[2 * i + 1] = tiny_malloc(64);
+        }
+        for(size_t i = 2 * BURST; i-- > 0; ) {
+            tiny_free(objects[i]);
+        }
+    }
+    double elapsed = now() - start;
+
+    printf(
+        "%-16s %8.2f ms, %6.2f ns per allocation and free\n",
+        argv[0], elapsed * 1e3, elapsed * 1e9 / ((double)rounds * 2 * BURST)
+    );
+    return objects[0] == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#define _POSIX_C_SOURCE 200809L
+#include "tiny.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures the latency of taking and first writing to memory, with the heap
+// faulted in lazily, populated up front, populated and locked, and faulted
+// in ahead of the allocations by `tiny_prefault()`. That is called on the
+// allocating thread between allocations, outside the time measured, as an
+// event loop would call it while idle.
+//
+// Usage:
+//     bench-prefault [HEAP_MIB [ALLOCATION_KIB]]
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static int compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// How many allocations ahead memory is prefaulted
+enum { PREFAULT_AHEAD = 4 };
+
+static void run(const char *name, unsigned flags, bool prefault, size_t heap_size, size_t size) {
+    double start = now();
+    if(!tiny_init_mapped(heap_size, flags)) {
+        printf("%-16s could not map %zu bytes\n", name, heap_size);
+        return;
+    }
+    double setup = now() - start;
+
+    size_t count = heap_size / (size + 64) - 1;
+    double *latencies = malloc(count * sizeof(double));
+    for(size_t i = 0; i < count; i++) {
+        start = now();
+        unsigned char *data = tiny_malloc(size);
+        if(data == NULL) {
+            abort();
+        }
+        memset(data, 0xff, size);
+        latencies[i] = now() - start;
+        if(prefault) {
+            tiny_prefault(PREFAULT_AHEAD * size);
+        }
+    }
+    qsort(latencies, count, sizeof(double), compare);
+    double total = 0;
+    for(size_t i = 0; i < count; i++) {
+        total += latencies[i];
+    }
+
+    printf(
+        "%-16s setup %8.2f ms, per allocation: mean %7.2f us, p50 %7.2f us, p99 %7.2f us, max %7.2f us\n",
+        name, setup * 1e3, total * 1e6 / count,
+        latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6, latencies[count - 1] * 1e6
+    );
+    free(latencies);
+    tiny_clear();
+}
+
+int main(int argc, char *argv[]) {
+    size_t heap_size = (argc > 1 ? strtoull(argv[1], NULL, 10) : 256) << 20;
+    size_t size = (argc > 2 ? strtoull(argv[2], NULL, 10) : 64) << 10;
+
+    run("lazy", 0, false, heap_size, size);
+    run("populate", TINY_MAP_POPULATE, false, heap_size, size);
+    run("populate+lock", TINY_MAP_POPULATE | TINY_MAP_LOCK, false, heap_size, size);
+    run("tiny_prefault", 0, true, heap_size, size);
+    return EXIT_SUCCESS;
+}
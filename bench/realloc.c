@@ -0,0 +1,79 @@
+#define _POSIX_C_SOURCE 200809L
+#include "tiny.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures large reallocations that move, as a buffer doubles up to some size
+// while allocations as large land right after it. Those would not fit in the
+// memory it leaves behind, so it never grows in place. Moves are done with
+// `memcpy()`, as they are with streaming disabled, and with streaming stores
+// from 4 MiB on.
+//
+// Usage:
+//     bench-realloc [MAX_MIB [ROUNDS]]
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Grows a buffer from 64 KiB to `max_size`, returning how many bytes moved
+static size_t grow(size_t max_size) {
+    size_t moved = 0, size = (size_t)64 << 10;
+    unsigned char *buffer = tiny_malloc(size);
+    void *blockers[64];
+    size_t blocker_count = 0;
+    memset(buffer, 1, size);
+    while(size < max_size && buffer != NULL) {
+        blockers[blocker_count++] = tiny_malloc(size);
+        unsigned char *grown = tiny_realloc(buffer, 2 * size);
+        if(grown == NULL) {
+            break;
+        }
+        moved += size;
+        buffer = grown;
+        size *= 2;
+    }
+    tiny_free(buffer);
+    while(blocker_count > 0) {
+        tiny_free(blockers[--blocker_count]);
+    }
+    return moved;
+}
+
+static void run(const char *name, size_t threshold, size_t max_size, size_t rounds, double *reference) {
+    tiny_set_stream_threshold(threshold);
+    // The first round faults the heap in
+    grow(max_size);
+    size_t moved = 0;
+    double start = now();
+    for(size_t round = 0; round < rounds; round++) {
+        moved += grow(max_size);
+    }
+    double elapsed = now() - start;
+    if(*reference == 0) {
+        *reference = elapsed;
+    }
+    printf(
+        "%-16s %8.2f ms, %6.2f GB/s moved (%.2fx)\n",
+        name, elapsed * 1e3, moved / elapsed * 1e-9, *reference / elapsed
+    );
+}
+
+int main(int argc, char *argv[]) {
+    size_t max_mib = argc > 1 ? strtoull(argv[1], NULL, 10) : 128;
+    size_t rounds = argc > 2 ? strtoull(argv[2], NULL, 10) : 20;
+    size_t max_size = max_mib << 20;
+    if(!tiny_init_mapped(4 * max_size, 0)) {
+        printf("could not map %zu bytes\n", 4 * max_size);
+        return EXIT_FAILURE;
+    }
+    double reference = 0;
+    run("memcpy", 0, max_size, rounds, &reference);
+    run("streaming", (size_t)4 << 20, max_size, rounds, &reference);
+    tiny_reset();
+    return EXIT_SUCCESS;
+}
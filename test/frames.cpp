@@ -0,0 +1,98 @@
+#define MUNIT_ENABLE_ASSERT_ALIASES
+#include "munit.h"
+#include "tiny-frames.hpp"
+#include <coroutine>
+
+// Tests of the coroutine frame allocator, called from the C suite
+
+namespace {
+
+tiny::frame_pool *test_pool;
+
+struct test_frames {
+    static tiny::frame_pool &pool() noexcept {
+        return *test_pool;
+    }
+};
+
+// A coroutine that runs until its first suspension point when resumed
+struct task {
+    struct promise_type : tiny::frame_allocated<test_frames> {
+        task get_return_object() {
+            return task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(int value) noexcept { result = value; }
+        void unhandled_exception() noexcept {}
+        int result = 0;
+    };
+
+    explicit task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    task(const task &) = delete;
+    ~task() {
+        handle.destroy();
+    }
+
+    int run() {
+        handle.resume();
+        return handle.promise().result;
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+task twice(int value) {
+    co_return 2 * value;
+}
+
+}
+
+extern "C" MunitResult test_frames(const MunitParameter params[], void *fixture) {
+    (void)params;
+    (void)fixture;
+    static unsigned char buffer[1 << 16];
+    tiny::heap_resource resource(buffer, sizeof(buffer));
+    tiny::frame_pool pool(resource);
+    test_pool = &pool;
+    std::size_t granularity = tiny::frame_pool::granularity;
+
+    // Frames of the same rounded size are recycled, last freed first
+    void *frame1 = pool.allocate(40);
+    void *frame2 = pool.allocate(granularity);
+    void *frame3 = pool.allocate(granularity + 1);
+    pool.deallocate(frame1, 40);
+    pool.deallocate(frame2, granularity);
+    assert_size(pool.cached(1), ==, 2);
+    assert_size(pool.cached(granularity + 1), ==, 0);
+    assert_ptr_equal(pool.allocate(1), frame2);
+    assert_ptr_equal(pool.allocate(granularity), frame1);
+    assert_ptr_not_equal(pool.allocate(granularity), frame3);
+
+    // Frames too large to be kept go back to the heap
+    void *large = pool.allocate(tiny::frame_pool::max_frame + 1);
+    pool.deallocate(large, tiny::frame_pool::max_frame + 1);
+    assert_ptr_equal(pool.allocate(tiny::frame_pool::max_frame + 1), large);
+
+    // Coroutine frames go through the pool of their promise type
+    pool.release();
+    {
+        task first = twice(21);
+        assert_int(first.run(), ==, 42);
+    }
+    std::size_t kept = 0;
+    for(std::size_t size = 1; size <= tiny::frame_pool::max_frame; size += granularity) {
+        kept += pool.cached(size);
+    }
+    assert_size(kept, ==, 1);
+    {
+        task second = twice(2);
+        assert_int(second.run(), ==, 4);
+        kept = 0;
+        for(std::size_t size = 1; size <= tiny::frame_pool::max_frame; size += granularity) {
+            kept += pool.cached(size);
+        }
+        assert_size(kept, ==, 0);
+    }
+    return MUNIT_OK;
+}
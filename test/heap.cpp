@@ -0,0 +1,99 @@
+#define MUNIT_ENABLE_ASSERT_ALIASES
+#include "munit.h"
+#include "tiny-heap.hpp"
+#include <cstdint>
+
+// Tests of the header-only heaps, called from the C suite
+
+template<typename Heap>
+static unsigned char *take(Heap &heap, std::size_t size) {
+    return static_cast<unsigned char *>(heap.malloc(size));
+}
+
+// Leaves a free section of 4 blocks followed by one of 2
+template<typename Heap>
+static void leave_gaps(Heap &heap, std::size_t block, unsigned char **large, unsigned char **small) {
+    *large = take(heap, 4 * block);
+    take(heap, block);
+    *small = take(heap, 2 * block);
+    take(heap, block);
+    heap.free(*large);
+    heap.free(*small);
+}
+
+extern "C" MunitResult test_basic_heap(const MunitParameter params[], void *fixture) {
+    (void)params;
+    (void)fixture;
+
+    // Sizes are known at compile time
+    using heap_type = tiny::basic_heap<1024, 16>;
+    static_assert(heap_type::block_size == 16);
+    static_assert(heap_type::header_blocks == 1);
+    static_assert(heap_type::total_blocks == 1024 / 16 - 2);
+    static_assert(heap_type::blocks_for(1) == 1 && heap_type::blocks_for(17) == 2);
+    static_assert(tiny::basic_heap<256, 4>::header_blocks == (sizeof(std::size_t) + 3) / 4);
+
+    static heap_type heap;
+    std::size_t block = heap_type::block_size, header = heap_type::header_size;
+    assert_null(heap.malloc(0));
+    assert_null(heap.malloc(heap_type::total_blocks * block + 1));
+
+    // Sections follow one another, aligned
+    unsigned char *obj1 = take(heap, 1);
+    unsigned char *obj2 = take(heap, 3 * block);
+    unsigned char *obj3 = take(heap, block);
+    assert_not_null(obj3);
+    assert_size((std::uintptr_t)obj1 % block, ==, 0);
+    assert_ptr_equal(obj2, obj1 + block + header);
+    assert_ptr_equal(obj3, obj2 + 3 * block + header);
+    assert_size(heap.usable_size(obj2), ==, 3 * block);
+    assert_true(heap.owns(obj3));
+    assert_false(heap.owns(&block));
+
+    // Freed sections are joined with the free sections after them
+    heap.free(obj2);
+    heap.free(obj1);
+    assert_ptr_equal(take(heap, 4 * block + header), obj1);
+    heap.free(obj1);
+
+    // Reallocating grows in place into free sections and moves otherwise
+    obj1 = take(heap, block);
+    assert_ptr_equal(heap.realloc(obj1, 2 * block), obj1);
+    obj1[2 * block - 1] = 42;
+    unsigned char *moved = static_cast<unsigned char *>(heap.realloc(obj1, 8 * block));
+    assert_ptr_not_equal(moved, obj1);
+    assert_uint8(moved[2 * block - 1], ==, 42);
+    assert_ptr_equal(heap.realloc(moved, block), moved);
+    assert_size(heap.usable_size(moved), ==, block);
+    assert_null(heap.realloc(moved, heap_type::total_blocks * block));
+    assert_size(heap.usable_size(moved), ==, block);
+
+    // The first free section that fits is taken, or the smallest one with
+    // best fit
+    heap.clear();
+    static tiny::basic_heap<1024, 16, tiny::best_fit> best;
+    unsigned char *large, *small;
+    leave_gaps(heap, block, &large, &small);
+    assert_ptr_equal(take(heap, 2 * block), large);
+    leave_gaps(best, block, &large, &small);
+    assert_ptr_equal(take(best, 2 * block), small);
+
+    // Counts that overflow are refused
+    assert_null(heap.calloc(static_cast<std::size_t>(-1), 2));
+    unsigned char *zeroed = static_cast<unsigned char *>(heap.calloc(4, block));
+    assert_not_null(zeroed);
+    for(std::size_t i = 0; i < 4 * block; i++) {
+        assert_uint8(zeroed[i], ==, 0);
+    }
+
+    // Blocks smaller than a header word take several per header
+    using words_type = tiny::basic_heap<256, 4>;
+    static words_type words;
+    unsigned char *word1 = take(words, 1);
+    unsigned char *word2 = take(words, 1);
+    assert_ptr_equal(word2, word1 + 4 + words_type::header_size);
+    words.free(word1);
+    words.free(word2);
+    assert_not_null(words.malloc(words_type::total_blocks * 4));
+    return MUNIT_OK;
+}
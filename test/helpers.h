@@ -63,7 +63,7 @@ struct tiny_test_section {
     tiny_section section = tiny_next_section(NULL);                     \
     size_t i = 0, size = sizeof(sections) / sizeof(sections[0]);        \
     size_t taken_blocks = 0, free_blocks = 0, total_blocks = 0;         \
-    size_t taken_sections = 0, free_sections = 0;                       \
+    size_t taken_sections = 0, free_sections = 0, largest_free = 0;     \
     while(section.data) {                                               \
         assert_size(i, <, size);                                        \
         assert_int(section.taken, ==, sections[i].taken);               \
@@ -74,6 +74,9 @@ struct tiny_test_section {
         } else {                                                        \
             free_sections++;                                            \
             free_blocks += section.size.blocks;                         \
+            if(section.size.blocks > largest_free) {                    \
+                largest_free = section.size.blocks;                     \
+            }                                                           \
         }                                                               \
         total_blocks +=                                                 \
             section.size.blocks + OBJ_BLOCKS(size_t, alignment);        \
@@ -89,6 +92,13 @@ struct tiny_test_section {
     assert_int(summary.sections.total, ==, i);                          \
     assert_int(summary.sections.free, ==, free_sections);               \
     assert_int(summary.sections.taken, ==, taken_sections);             \
+    tiny_stats stats = tiny_statistics();                               \
+    assert_int(stats.taken.blocks, ==, taken_blocks);                   \
+    assert_int(stats.free.blocks, ==, free_blocks);                     \
+    assert_int(stats.largest_free.blocks, ==, largest_free);            \
+    assert_int(stats.sections.total, ==, i);                            \
+    assert_int(stats.sections.free, ==, free_sections);                 \
+    assert_int(stats.sections.taken, ==, taken_sections);               \
 } while(0)
 
 #endif /* end of guard: TINY_TEST_HELPERS_H */
\ No newline at end of file
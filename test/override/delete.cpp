@@ -0,0 +1,61 @@
+#include "tiny.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Exercises every global `operator delete` of `tiny-override-cxx.o` linked
+// standalone, without `tiny-override.c`, so that deletes go straight to tiny.
+// Exits with a failure if memory is not given back, or crashes if a delete
+// does not reach tiny.
+//
+// Usage:
+//     test-delete
+
+alignas(64) static unsigned char buffer[1 << 16];
+
+static int fail(const char *message) {
+    std::fprintf(stderr, "test-delete: %s\n", message);
+    return EXIT_FAILURE;
+}
+
+// Checks that the heap holds no taken sections
+static bool empty() {
+    return tiny_inspect().sections.taken == 0;
+}
+
+int main() {
+    const std::align_val_t alignment{64};
+    const std::nothrow_t &nothrow = std::nothrow;
+    tiny_init(buffer, sizeof(buffer));
+
+    void *data = ::operator new(100);
+    if(!tiny_owns(data)) {
+        return fail("operator new not served by tiny");
+    }
+    ::operator delete(data);
+    ::operator delete[](::operator new[](100));
+    ::operator delete(::operator new(100, nothrow), nothrow);
+    ::operator delete[](::operator new[](100, nothrow), nothrow);
+    if(!empty()) {
+        return fail("unsized delete did not free");
+    }
+
+    ::operator delete(::operator new(100, alignment), alignment);
+    ::operator delete[](::operator new[](100, alignment), alignment);
+    ::operator delete(::operator new(100, alignment, nothrow), alignment, nothrow);
+    ::operator delete[](::operator new[](100, alignment, nothrow), alignment, nothrow);
+    if(!empty()) {
+        return fail("unsized aligned delete did not free");
+    }
+
+    ::operator delete(::operator new(100), 100);
+    ::operator delete[](::operator new[](100), 100);
+    ::operator delete(::operator new(100, alignment), 100, alignment);
+    ::operator delete[](::operator new[](100, alignment), 100, alignment);
+    if(!empty()) {
+        return fail("sized delete did not free");
+    }
+
+    ::operator delete(nullptr);
+    return EXIT_SUCCESS;
+}
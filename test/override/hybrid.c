@@ -0,0 +1,100 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Exercises the hybrid overrides from a program that knows nothing of tiny,
+// run by `make test` with `libtiny-hybrid.so` preloaded. Exits with a failure,
+// or is aborted by the next allocator, if a pointer is handed to the wrong
+// allocator.
+//
+// Usage:
+//     TINY_CONF=size=1M,grow=1M LD_PRELOAD=dist/libtiny-hybrid.so test-hybrid grow|move|mallopt
+
+static bool (*owns)(const void *);
+
+static int fail(const char *message) {
+    fprintf(stderr, "test-hybrid: %s\n", message);
+    return EXIT_FAILURE;
+}
+
+// Takes more small allocations than the initial heap holds, so that it grows,
+// and frees them
+static int grow(void) {
+    enum { COUNT = 20000 };
+    static void *objects[COUNT];
+    size_t grown = 0;
+    for(size_t i = 0; i < COUNT; i++) {
+        objects[i] = malloc(200);
+        if(objects[i] == NULL || !owns(objects[i])) {
+            return fail("small allocation not served by tiny");
+        }
+        memset(objects[i], (int)i, 200);
+    }
+    for(size_t i = 0; i < COUNT; i += 2) {
+        objects[i] = realloc(objects[i], 400);
+        grown += objects[i] != NULL;
+    }
+    for(size_t i = 0; i < COUNT; i++) {
+        free(objects[i]);
+    }
+    return grown == COUNT / 2 ? EXIT_SUCCESS : fail("reallocation failed");
+}
+
+// Reallocates a small allocation in and out of tiny
+static int move(void) {
+    unsigned char *data = malloc(512);
+    if(data == NULL) {
+        return fail("small allocation failed");
+    }
+    memset(data, 42, 512);
+    if(!owns(data)) {
+        return fail("small allocation not served by tiny");
+    }
+    data = realloc(data, 600);
+    if(data == NULL) {
+        return fail("small reallocation failed");
+    }
+    memset(data + 512, 42, 600 - 512);
+    if(!owns(data)) {
+        return fail("small reallocation not served by tiny");
+    }
+    data = realloc(data, 1 << 20);
+    if(data == NULL || owns(data) || data[511] != 42) {
+        return fail("large reallocation not moved to the next allocator");
+    }
+    free(data);
+    return EXIT_SUCCESS;
+}
+
+// Asks for mappings from a small size on, which only the next allocator takes,
+// then moves a small allocation
+static int tune(void) {
+    #ifdef M_MMAP_THRESHOLD
+    if(mallopt(M_MMAP_THRESHOLD, 256) != 1) {
+        return fail("mallopt() refused the mapping threshold");
+    }
+    #endif
+    return move();
+}
+
+int main(int argc, char *argv[]) {
+    void *symbol = dlsym(RTLD_DEFAULT, "tiny_owns");
+    if(symbol == NULL) {
+        return fail("run with libtiny-hybrid.so preloaded");
+    }
+    memcpy(&owns, &symbol, sizeof(symbol));
+    if(argc > 1 && strcmp(argv[1], "grow") == 0) {
+        return grow();
+    } else if(argc > 1 && strcmp(argv[1], "move") == 0) {
+        return move();
+    } else if(argc > 1 && strcmp(argv[1], "mallopt") == 0) {
+        return tune();
+    }
+    return fail("unknown scenario");
+}
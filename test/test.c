@@ -1,7 +1,16 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 #define MUNIT_ENABLE_ASSERT_ALIASES
 #include "munit.h"
 #include "helpers.h"
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 static MunitResult test_init_clear_reset(const MunitParameter params[], void* fixture) {
     tiny_reset();
@@ -285,6 +294,1170 @@ static MunitResult test_out_of_memory(const MunitParameter params[], void *fixtu
     return MUNIT_OK;
 }
 
+struct hook_counters {
+    size_t allocate, free, realloc, moved, split, merge, out_of_memory;
+};
+
+static void count_allocate(void *context, void *ptr, size_t size) {
+    ((struct hook_counters *)context)->allocate++;
+}
+
+static void count_free(void *context, void *ptr, size_t size) {
+    ((struct hook_counters *)context)->free++;
+}
+
+static void count_realloc(void *context, void *old_ptr, size_t old_size, void *new_ptr, size_t size) {
+    struct hook_counters *counters = context;
+    counters->realloc++;
+    if(old_ptr != new_ptr) {
+        counters->moved++;
+    }
+}
+
+static void count_split(void *context, void *header, size_t blocks, void *remainder, size_t remainder_blocks) {
+    ((struct hook_counters *)context)->split++;
+}
+
+static void count_merge(void *context, void *header, void *absorbed, size_t blocks) {
+    ((struct hook_counters *)context)->merge++;
+}
+
+static void count_out_of_memory(void *context, enum tiny_function function, size_t size) {
+    ((struct hook_counters *)context)->out_of_memory++;
+}
+
+static MunitResult test_hooks(const MunitParameter params[], void *fixture) {
+    DECLARE_HEAP(2048, 2, 6);
+
+    struct hook_counters counters = { 0 };
+    tiny_hooks hooks = { 
+        &counters,
+        count_allocate,
+        count_free,
+        count_realloc,
+        count_split,
+        count_merge,
+        count_out_of_memory
+    };
+    tiny_set_hooks(&hooks);
+
+    void *obj1 = tiny_malloc(obj_size);
+    void *obj2 = tiny_malloc(obj_size);
+    assert_size(counters.allocate, ==, 2);
+    assert_size(counters.split, ==, 2);
+
+    void *obj3 = tiny_realloc(obj2, 2 * obj_size);
+    assert_ptr_equal(obj2, obj3);
+    assert_size(counters.realloc, ==, 1);
+    assert_size(counters.moved, ==, 0);
+    assert_size(counters.merge, ==, 1);
+
+    void *obj4 = tiny_realloc(obj1, 2 * obj_size);
+    assert_ptr_not_equal(obj1, obj4);
+    assert_size(counters.realloc, ==, 2);
+    assert_size(counters.moved, ==, 1);
+    assert_size(counters.allocate, ==, 3);
+    assert_size(counters.free, ==, 1);
+
+    void *obj5 = tiny_malloc(size);
+    assert_ptr_null(obj5);
+    assert_size(counters.out_of_memory, ==, 1);
+
+    tiny_free(obj3);
+    tiny_free(obj4);
+    assert_size(counters.free, ==, 3);
+    ASSERT_HEAP({ { false, available_blocks } });
+
+    tiny_set_hooks(NULL);
+    struct hook_counters snapshot = counters;
+    void *obj6 = tiny_malloc(obj_size);
+    tiny_free(obj6);
+    assert_memory_equal(sizeof(counters), &counters, &snapshot);
+
+    return MUNIT_OK;
+}
+
+struct dump_buffer {
+    size_t length;
+    char data[4096];
+};
+
+static void dump_to_buffer(void *context, const char *data, size_t length) {
+    struct dump_buffer *buffer = context;
+    assert_size(buffer->length + length, <, sizeof(buffer->data));
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static MunitResult test_dump(const MunitParameter params[], void *fixture) {
+    DECLARE_HEAP(2048, 2, 6);
+
+    void *obj1 = tiny_malloc(obj_size);
+    void *obj2 = tiny_malloc(obj_size);
+    tiny_free(obj1);
+
+    struct hook_counters counters = { 0 };
+    tiny_hooks hooks = { &counters, count_allocate, NULL, NULL, NULL, NULL, NULL };
+    tiny_set_hooks(&hooks);
+
+    struct dump_buffer text = { 0 };
+    tiny_dump(dump_to_buffer, &text, TINY_DUMP_ALL, TINY_TEXT);
+    assert_not_null(strstr(text.data, "|  Tiny summary  |"));
+    assert_not_null(strstr(text.data, "Sections: 3 in total, 2 free, 1 taken\n"));
+    assert_not_null(strstr(text.data, "Operation: TINY_FREE\nStatus: success\n"));
+    assert_not_null(strstr(text.data, "Section 2:\n    Taken: no\n"));
+    assert_not_null(strstr(text.data, "No more sections\n"));
+
+    struct dump_buffer json = { 0 };
+    tiny_dump(dump_to_buffer, &json, TINY_DUMP_SUMMARY | TINY_DUMP_HEAP, TINY_JSON);
+    assert_char(json.data[0], ==, '{');
+    assert_string_equal(json.data + json.length - 3, "]}\n");
+    assert_not_null(strstr(json.data, "\"sections\":{\"total\":3,\"free\":2,\"taken\":1}"));
+    assert_null(strstr(json.data, "\"last_operation\""));
+    assert_not_null(strstr(json.data, "\"heap\":[{\"taken\":false,"));
+    assert_not_null(strstr(json.data, "},{\"taken\":true,"));
+
+    assert_size(counters.allocate, ==, 0);
+    tiny_set_hooks(NULL);
+    tiny_free(obj2);
+
+    tiny_clear();
+    struct dump_buffer cleared = { 0 };
+    tiny_dump(dump_to_buffer, &cleared, TINY_DUMP_HEAP, TINY_JSON);
+    assert_string_equal(cleared.data, "{\"heap\":null}\n");
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_statistics(const MunitParameter params[], void *fixture) {
+    DECLARE_HEAP(2048, 2, 6);
+
+    tiny_stats initial = tiny_statistics();
+    void *obj1 = tiny_malloc(obj_size);
+    void *obj2 = tiny_malloc(obj_size);
+    tiny_free(obj1);
+
+    tiny_stats stats = tiny_statistics();
+    assert_size(stats.peak.blocks, ==, 2 * obj_blocks);
+    assert_size(stats.taken.blocks, ==, obj_blocks);
+    assert_size(stats.operations[TINY_MALLOC] - initial.operations[TINY_MALLOC], ==, 2);
+    assert_size(stats.operations[TINY_FREE] - initial.operations[TINY_FREE], ==, 1);
+
+    char name[64];
+    snprintf(name, sizeof(name), "/tiny-test-%ld", (long)getpid());
+    assert_true(tiny_publish(name));
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    assert_int(fd, >=, 0);
+    const tiny_stats_page *page = mmap(
+        NULL, sizeof(tiny_stats_page), PROT_READ, MAP_SHARED, fd, 0
+    );
+    close(fd);
+    assert_ptr_not_equal(page, MAP_FAILED);
+    assert_uint(page->magic, ==, TINY_STATS_MAGIC);
+    assert_long(page->pid, ==, (long)getpid());
+
+    // Every operation publishes its count and free and taken memory
+    assert_size(page->stats.largest_free.blocks, ==, tiny_statistics().largest_free.blocks);
+    size_t sequence = page->sequence;
+    size_t frees = page->stats.operations[TINY_FREE];
+    tiny_free(obj2);
+    assert_size(page->sequence, ==, sequence + 2);
+    assert_size(page->stats.operations[TINY_FREE], ==, frees + 1);
+    assert_size(page->stats.taken.blocks, ==, 0);
+    assert_size(page->stats.free.blocks, ==, available_blocks);
+
+    // And every so many operations, everything else
+    for(size_t i = 0; i < 64; i++) {
+        tiny_free(NULL);
+    }
+    assert_size(page->stats.largest_free.blocks, ==, available_blocks);
+    assert_size(page->stats.sections.total, ==, 1);
+
+    munmap((void *)page, sizeof(tiny_stats_page));
+    assert_true(tiny_publish(NULL));
+    assert_int(shm_open(name, O_RDONLY, 0), <, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_snapshot(const MunitParameter params[], void *fixture) {
+    DECLARE_HEAP(2048, 2, 6);
+
+    void *obj1 = tiny_malloc(obj_size);
+    void *obj2 = tiny_malloc(obj_size);
+    tiny_free(obj1);
+
+    int fds[2];
+    assert_int(pipe(fds), ==, 0);
+    assert_true(tiny_snapshot(fds[1]));
+    close(fds[1]);
+
+    tiny_snapshot_header header;
+    tiny_snapshot_record records[4];
+    assert_int(read(fds[0], &header, sizeof(header)), ==, sizeof(header));
+    assert_memory_equal(sizeof(header.magic), header.magic, TINY_SNAPSHOT_MAGIC);
+    assert_uint(header.version, ==, TINY_SNAPSHOT_VERSION);
+    assert_uint(header.alignment, ==, alignment);
+    assert_uint(header.last_function, ==, TINY_FREE);
+    assert_size(header.total_blocks, ==, available_blocks);
+    assert_size(header.section_count, ==, 3);
+    assert_int(read(fds[0], records, sizeof(records)), ==, 3 * sizeof(records[0]));
+    close(fds[0]);
+
+    assert_size(records[0].offset, ==, 0);
+    assert_size(records[0].blocks, ==, obj_blocks);
+    assert_uint(records[0].flags, ==, 0);
+    assert_size(records[1].offset, ==, obj_section);
+    assert_uint(records[1].flags, ==, TINY_SNAPSHOT_TAKEN);
+    assert_size(records[2].offset, ==, 2 * obj_section);
+    assert_size(records[2].blocks, ==, available_blocks - 2 * obj_section);
+
+    tiny_free(obj2);
+    return MUNIT_OK;
+}
+
+static MunitResult test_lifetimes(const MunitParameter params[], void *fixture) {
+    DECLARE_HEAP(2048, 1, 16);
+
+    uint64_t stamps[2048 / sizeof(max_align_t)];
+    assert_false(tiny_profile_lifetimes(stamps, 1));
+    assert_true(tiny_profile_lifetimes(stamps, sizeof(stamps) / sizeof(stamps[0])));
+
+    void *obj1 = tiny_malloc(obj_size);
+    void *obj2 = tiny_malloc(4 * obj_size);
+    void *obj3 = tiny_malloc(obj_size);
+    tiny_free(obj1);
+    obj2 = tiny_realloc(obj2, 6 * obj_size);
+    tiny_free(obj3);
+    tiny_free(obj2);
+
+    tiny_lifetimes lifetimes = tiny_inspect_lifetimes();
+    assert_size(lifetimes.epoch, ==, 4);
+    assert_size(lifetimes.sizes[0].freed, ==, 2);
+    assert_size(lifetimes.sizes[0].total_lifetime, ==, 3 + 2);
+    assert_size(lifetimes.sizes[0].histogram[1], ==, 2);
+    assert_size(lifetimes.sizes[2].freed, ==, 1);
+    assert_size(lifetimes.sizes[2].total_lifetime, ==, 3);
+    assert_size(lifetimes.sizes[2].histogram[1], ==, 1);
+
+    struct dump_buffer json = { 0 };
+    tiny_dump(dump_to_buffer, &json, TINY_DUMP_LIFETIMES, TINY_JSON);
+    assert_not_null(strstr(json.data, "{\"min_blocks\":1,\"freed\":2,\"total_lifetime\":5,"));
+
+    assert_true(tiny_profile_lifetimes(NULL, 0));
+    return MUNIT_OK;
+}
+
+static MunitResult test_tags(const MunitParameter params[], void *fixture) {
+    DECLARE_HEAP(2048, 2, 8);
+
+    void *obj1 = tiny_malloc_tagged(obj_size, 3);
+    assert_not_null(obj1);
+    assert_null(tiny_malloc_tagged(obj_size, TINY_TAGS));
+
+    unsigned previous = tiny_tag_scope(5);
+    void *obj2 = tiny_malloc(obj_size);
+    void *obj3 = tiny_calloc(2, obj_size);
+    assert_uint(tiny_tag_scope(previous), ==, 5);
+
+    // Tags out of range are ignored
+    assert_uint(tiny_tag_scope(TINY_TAGS), ==, previous);
+    assert_uint(tiny_tag_scope(previous), ==, previous);
+    void *obj4 = tiny_malloc(obj_size);
+
+    assert_uint(tiny_next_section(NULL).tag, ==, 3);
+    assert_uint(tiny_next_section(tiny_next_section(NULL).header).tag, ==, 5);
+    ASSERT_HEAP({
+        { true, obj_blocks },
+        { true, obj_blocks },
+        { true, 2 * obj_blocks },
+        { true, obj_blocks },
+        { false, available_blocks - 4 * obj_section - obj_blocks }
+    });
+
+    tiny_tag_stats tag5 = tiny_inspect_tag(5);
+    assert_size(tag5.live.blocks, ==, 3 * obj_blocks);
+    assert_size(tag5.allocations, ==, 2);
+
+    obj1 = tiny_realloc(obj1, 3 * obj_size);
+    tiny_free(obj2);
+    tiny_free(obj3);
+
+    tiny_summary summary = tiny_inspect();
+    assert_size(summary.tags[3].live.blocks, ==, 3 * obj_blocks);
+    assert_size(summary.tags[3].allocations, ==, 2);
+    assert_size(summary.tags[5].live.blocks, ==, 0);
+    assert_size(summary.tags[5].peak.blocks, ==, 3 * obj_blocks);
+    assert_size(summary.tags[previous].live.blocks, ==, obj_blocks);
+
+    tiny_free(obj1);
+    tiny_free(obj4);
+    ASSERT_HEAP({ { false, available_blocks } });
+
+    return MUNIT_OK;
+}
+
+struct growth_pool {
+    union {
+        max_align_t alignment;
+        unsigned char data[8192];
+    } pool;
+    size_t used, released;
+};
+
+static void *pool_grow(void *context, void *hint, size_t size) {
+    struct growth_pool *pool = context;
+    if(pool->used + size > sizeof(pool->pool.data)) {
+        return NULL;
+    }
+    pool->used += size;
+    return pool->pool.data + pool->used - size;
+}
+
+static void pool_release(void *context, void *chunk, size_t size) {
+    struct growth_pool *pool = context;
+    pool->released += size;
+}
+
+static void *fixed_grow(void *context, void *hint, size_t size) {
+    void *chunk = mmap(
+        (unsigned char *)context + 65536, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0
+    );
+    return chunk == MAP_FAILED ? NULL : chunk;
+}
+
+static MunitResult test_growth(const MunitParameter params[], void *fixture) {
+    static struct growth_pool pool;
+    tiny_growth growth = { &pool, pool_grow, pool_release, 1024 };
+    {
+        // Adjacent chunks join into a single region
+        tiny_clear();
+        tiny_set_growth(&growth);
+
+        size_t alignment = tiny_block_size();
+        size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+        void *obj1 = tiny_malloc(100);
+        void *obj2 = tiny_malloc(2000);
+        assert_not_null(obj1);
+        assert_not_null(obj2);
+        assert_size(pool.used, ==, 3072);
+        size_t pool_blocks = pool.used / alignment - 4 * header_blocks;
+        ASSERT_HEAP({
+            { true, SIZE_BLOCKS(100, alignment) },
+            { true, SIZE_BLOCKS(2000, alignment) },
+            { false, pool_blocks - SIZE_BLOCKS(100, alignment) - SIZE_BLOCKS(2000, alignment) }
+        });
+        assert_null(tiny_malloc(8192));
+
+        tiny_set_growth(NULL);
+        tiny_clear();
+    }
+
+    // Chunks that are apart are bridged, and released when shrinking. Chunks
+    // are placed at a fixed distance from the initial buffer.
+    unsigned char *reserved = mmap(
+        NULL, 131072, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    assert_ptr_not_equal(reserved, MAP_FAILED);
+    DECLARE_HEAP(2048, 2, 8);
+    growth = (tiny_growth){ reserved, fixed_grow, NULL, 65536 };
+    tiny_init(reserved, size);
+    tiny_set_growth(&growth);
+
+    size_t large_blocks = SIZE_BLOCKS(8192, alignment);
+    size_t chunk_blocks = 65536 / alignment - 3 * header_blocks;
+    void *obj3 = tiny_malloc(8192);
+    void *obj4 = tiny_malloc(obj_size);
+    assert_not_null(obj3);
+    assert_not_null(obj4);
+    ASSERT_HEAP({
+        { true, obj_blocks },
+        { false, available_blocks - obj_section },
+        { true, large_blocks },
+        { false, chunk_blocks - large_blocks }
+    });
+    memset(obj3, 0xff, 8192);
+    assert_true(tiny_owns(obj3));
+
+    // Only whole trailing pages are released while the chunk is in use
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t kept = ALIGN((size_t)obj3 + 8192 + (2 * header_blocks + 1) * alignment, page);
+    size_t trimmed = ALIGN((size_t)obj3 - header_blocks * alignment + 65536, page) - kept;
+    assert_size(tiny_shrink(), ==, trimmed);
+    ASSERT_HEAP({
+        { true, obj_blocks },
+        { false, available_blocks - obj_section },
+        { true, large_blocks },
+        { false, chunk_blocks - large_blocks - trimmed / alignment }
+    });
+
+    tiny_free(obj3);
+    assert_size(tiny_shrink(), ==, 65536 - trimmed);
+    assert_false(tiny_owns(obj3));
+    tiny_free(obj4);
+    ASSERT_HEAP({ { false, available_blocks } });
+
+    tiny_set_growth(NULL);
+    assert_null(tiny_malloc(8192));
+    tiny_clear();
+    munmap(reserved, 131072);
+    return MUNIT_OK;
+}
+
+static MunitResult test_reserved(const MunitParameter params[], void *fixture) {
+    assert_false(tiny_init_reserved(1));
+    assert_true(tiny_init_reserved((size_t)1 << 30));
+    ASSERT_OP(INIT, true, (size_t)1 << 30);
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+    size_t total_blocks = ((size_t)1 << 30) / alignment - 2 * header_blocks;
+    ASSERT_HEAP({ { false, total_blocks } });
+
+    // Memory is committed as sections are taken
+    size_t obj_size = (size_t)1 << 20, large_size = (size_t)4 << 20;
+    unsigned char *obj1 = tiny_malloc(obj_size);
+    unsigned char *obj2 = tiny_malloc(large_size);
+    assert_not_null(obj1);
+    assert_not_null(obj2);
+    memset(obj1, 0xff, obj_size);
+    memset(obj2, 0xff, large_size);
+
+    // And decommitted when the end of the heap goes free
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    static unsigned char resident[((size_t)4 << 20) / 4096];
+    unsigned char *first_page = (unsigned char *)ALIGN((uintptr_t)obj2 + page, page);
+    size_t pages = (large_size - 2 * page) / page;
+    assert_size(pages, <=, sizeof(resident));
+    assert_int(mincore(first_page, pages * page, resident), ==, 0);
+    assert_int(resident[pages - 1] & 1, ==, 1);
+    tiny_free(obj2);
+    assert_int(mincore(first_page, pages * page, resident), ==, 0);
+    for(size_t i = 0; i < pages; i++) {
+        assert_int(resident[i] & 1, ==, 0);
+    }
+    ASSERT_HEAP({
+        { true, SIZE_BLOCKS(obj_size, alignment) },
+        { false, total_blocks - SIZE_BLOCKS(obj_size, alignment) - header_blocks }
+    });
+
+    // Decommitted memory is committed again when taken
+    obj2 = tiny_malloc(large_size);
+    assert_not_null(obj2);
+    memset(obj2, 0xff, large_size);
+    tiny_free(obj1);
+    tiny_free(obj2);
+    ASSERT_HEAP({ { false, total_blocks } });
+
+    // The decay stamp of what remains is committed along with its header, even
+    // when that header ends a commit step
+    assert_true(tiny_init_reserved((size_t)1 << 26));
+    assert_true(tiny_set_decay(1000));
+    obj1 = tiny_malloc(((size_t)128 << 10) - 2 * alignment);
+    assert_not_null(obj1);
+    tiny_free(obj1);
+    assert_true(tiny_set_decay(0));
+
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_mapped(const MunitParameter params[], void *fixture) {
+    DECLARE_HEAP(2048, 2, 8);
+    tiny_set_mmap_threshold(65536);
+
+    // Large allocations leave the heap untouched
+    size_t large_size = (size_t)1 << 20;
+    unsigned char *obj1 = tiny_malloc_tagged(large_size, 2);
+    assert_not_null(obj1);
+    assert_size((uintptr_t)obj1 % alignment, ==, 0);
+    memset(obj1, 0xab, large_size);
+    ASSERT_HEAP({ { false, available_blocks } });
+    tiny_stats stats = tiny_statistics();
+    assert_size(stats.mappings, ==, 1);
+    assert_size(stats.mapped.bytes, >=, large_size);
+    assert_size(tiny_inspect_tag(2).live.bytes, ==, stats.mapped.bytes);
+
+    // Are resized in place or remapped, keeping their contents
+    obj1 = tiny_realloc(obj1, 8 * large_size);
+    assert_not_null(obj1);
+    assert_int(obj1[0], ==, 0xab);
+    assert_int(obj1[large_size - 1], ==, 0xab);
+    memset(obj1, 0xcd, 8 * large_size);
+    obj1 = tiny_realloc(obj1, obj_size);
+    assert_not_null(obj1);
+    assert_int(obj1[obj_size - 1], ==, 0xcd);
+    ASSERT_OP(REALLOC, true, obj_size);
+
+    // Heap sections that outgrow the threshold move to their own mapping
+    unsigned char *obj2 = tiny_malloc(obj_size);
+    memset(obj2, 0xef, obj_size);
+    obj2 = tiny_realloc(obj2, large_size);
+    assert_not_null(obj2);
+    assert_int(obj2[obj_size - 1], ==, 0xef);
+    ASSERT_HEAP({ { false, available_blocks } });
+    assert_size(tiny_statistics().mappings, ==, 2);
+
+    // Shrunk to a single page
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    tiny_free(obj1);
+    ASSERT_OP(FREE, true, (page - 2 * header_blocks * alignment) / alignment);
+    tiny_free(obj2);
+    stats = tiny_statistics();
+    assert_size(stats.mappings, ==, 0);
+    assert_size(stats.mapped.bytes, ==, 0);
+    assert_size(tiny_inspect_tag(2).live.bytes, ==, 0);
+
+    tiny_set_mmap_threshold(0);
+    assert_null(tiny_malloc(large_size));
+    return MUNIT_OK;
+}
+
+static MunitResult test_trim(const MunitParameter params[], void *fixture) {
+    size_t heap_size = (size_t)1 << 20, obj_size = (size_t)1 << 18;
+    unsigned char *buffer = mmap(
+        NULL, heap_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    assert_ptr_not_equal(buffer, MAP_FAILED);
+    tiny_init(buffer, heap_size);
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+    size_t obj_blocks = SIZE_BLOCKS(obj_size, alignment);
+    size_t available_blocks = heap_size / alignment - 2 * header_blocks;
+    size_t rest_blocks = available_blocks - 3 * (obj_blocks + header_blocks);
+
+    unsigned char *obj1 = tiny_malloc(obj_size);
+    unsigned char *obj2 = tiny_malloc(obj_size);
+    unsigned char *obj3 = tiny_malloc(obj_size);
+    memset(obj1, 0xff, obj_size);
+    memset(obj2, 0xff, obj_size);
+    memset(obj3, 0xff, obj_size);
+
+    // Free sections are purged, past their header
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    static unsigned char resident[((size_t)1 << 18) / 4096];
+    unsigned char *interior = (unsigned char *)ALIGN((uintptr_t)obj2 + alignment, page);
+    size_t pages = (obj_size - 2 * page) / page;
+    assert_size(pages, <=, sizeof(resident));
+    tiny_free(obj2);
+    assert_size(tiny_trim(0), >=, pages * page);
+    assert_int(mincore(interior, pages * page, resident), ==, 0);
+    for(size_t i = 0; i < pages; i++) {
+        assert_int(resident[i] & 1, ==, 0);
+    }
+    ASSERT_HEAP({
+        { true, obj_blocks },
+        { false, obj_blocks },
+        { true, obj_blocks },
+        { false, rest_blocks }
+    });
+
+    // Only once they have decayed
+    assert_true(tiny_set_decay(20));
+    obj2 = tiny_malloc(obj_size);
+    memset(obj2, 0xff, obj_size);
+    tiny_free(obj2);
+    assert_size(tiny_purge(), ==, 0);
+    struct timespec delay = { 0, 40 * 1000 * 1000 };
+    nanosleep(&delay, NULL);
+    assert_size(tiny_purge(), >=, pages * page);
+    assert_int(mincore(interior, pages * page, resident), ==, 0);
+    assert_int(resident[0] & 1, ==, 0);
+    assert_size(tiny_purge(), ==, 0);
+
+    tiny_free(obj1);
+    tiny_free(obj3);
+    ASSERT_HEAP({ { false, available_blocks } });
+    assert_true(tiny_set_decay(0));
+
+    // The end of the heap is trimmed on free once enough of it was taken
+    tiny_set_trim_threshold(obj_size, page);
+    obj1 = tiny_malloc(obj_size / 2);
+    memset(obj1, 0xff, obj_size / 2);
+    tiny_free(obj1);
+    interior = (unsigned char *)ALIGN((uintptr_t)obj1 + 2 * page, page);
+    assert_int(mincore(interior, page, resident), ==, 0);
+    assert_int(resident[0] & 1, ==, 1);
+    obj1 = tiny_malloc(2 * obj_size);
+    memset(obj1, 0xff, 2 * obj_size);
+    tiny_free(obj1);
+    assert_int(mincore(interior, pages * page, resident), ==, 0);
+    for(size_t i = 0; i < pages; i++) {
+        assert_int(resident[i] & 1, ==, 0);
+    }
+    tiny_set_trim_threshold(0, 0);
+    tiny_reset();
+    munmap(buffer, heap_size);
+    return MUNIT_OK;
+}
+
+static MunitResult test_huge_pages(const MunitParameter params[], void *fixture) {
+    size_t huge_page = (size_t)2 << 20, page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+
+    // Huge pages may not be available, but the heap is mapped regardless
+    assert_true(tiny_init_mapped(3 << 20, TINY_MAP_HUGETLB | TINY_MAP_HUGEPAGE));
+    ASSERT_OP(INIT, true, 2 * huge_page);
+    tiny_summary summary = tiny_inspect();
+    assert_size((uintptr_t)summary.buffer % huge_page, ==, 0);
+    assert_true(summary.page_size == huge_page || summary.page_size == page);
+    ASSERT_HEAP({ { false, 2 * huge_page / alignment - 2 * header_blocks } });
+
+    unsigned char *obj = tiny_malloc(huge_page);
+    assert_not_null(obj);
+    memset(obj, 0xff, huge_page);
+    tiny_free(obj);
+
+    // Transparent huge pages are not relied upon
+    assert_true(tiny_init_mapped(1, TINY_MAP_HUGEPAGE));
+    assert_size(tiny_inspect().page_size, ==, page);
+
+    assert_true(tiny_init_mapped(1, 0));
+    assert_size(tiny_inspect().page_size, ==, page);
+    ASSERT_HEAP({ { false, huge_page / alignment - 2 * header_blocks } });
+
+    tiny_reset();
+    assert_size(tiny_inspect().page_size, ==, page);
+    return MUNIT_OK;
+}
+
+static MunitResult test_prefault(const MunitParameter params[], void *fixture) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE), heap_size = (size_t)2 << 20;
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+    static unsigned char resident[((size_t)2 << 20) / 4096];
+    size_t pages = heap_size / page;
+    assert_size(pages, <=, sizeof(resident));
+
+    // The whole buffer is faulted in and locked up front
+    assert_true(tiny_init_mapped(heap_size, TINY_MAP_POPULATE | TINY_MAP_LOCK));
+    tiny_summary summary = tiny_inspect();
+    assert_int(mincore(summary.buffer, heap_size, resident), ==, 0);
+    for(size_t i = 0; i < pages; i++) {
+        assert_int(resident[i] & 1, ==, 1);
+    }
+
+    // Reserved memory is committed and faulted in ahead of allocations
+    assert_true(tiny_init_reserved((size_t)64 << 20));
+    unsigned char *obj1 = tiny_malloc(page);
+    assert_size(tiny_prefault(heap_size), ==, heap_size);
+    unsigned char *start = (unsigned char *)ALIGN((uintptr_t)obj1 + page, page);
+    assert_int(mincore(start, heap_size - page, resident), ==, 0);
+    for(size_t i = 0; i < pages - 1; i++) {
+        assert_int(resident[i] & 1, ==, 1);
+    }
+    unsigned char *obj2 = tiny_malloc(heap_size);
+    assert_not_null(obj2);
+    memset(obj2, 0xff, heap_size);
+
+    // Growable heaps grow ahead of allocations
+    tiny_clear();
+    tiny_growth growth = { NULL, NULL, NULL, heap_size };
+    tiny_set_growth(&growth);
+    assert_size(tiny_prefault(page), ==, page);
+    ASSERT_HEAP({ { false, heap_size / alignment - 2 * header_blocks } });
+    assert_size(tiny_prefault(2 * heap_size), ==, 2 * heap_size);
+
+    tiny_set_growth(NULL);
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_numa(const MunitParameter params[], void *fixture) {
+    size_t heap_size = (size_t)2 << 20;
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+
+    // On a single node, there is a single heap and routing does nothing
+    assert_true(tiny_init_numa(heap_size, 0));
+    assert_uint(tiny_numa_nodes(), >=, 1);
+    tiny_set_numa_routing(true);
+    void *objs[256];
+    for(size_t i = 0; i < 256; i++) {
+        objs[i] = tiny_malloc(alignment);
+        assert_not_null(objs[i]);
+    }
+    objs[0] = tiny_realloc(objs[0], 2 * alignment);
+    assert_not_null(objs[0]);
+    for(size_t i = 0; i < 256; i++) {
+        tiny_free(objs[i]);
+    }
+    if(tiny_numa_nodes() == 1) {
+        ASSERT_HEAP({ { false, heap_size / alignment - 2 * header_blocks } });
+    }
+
+    tiny_set_numa_routing(false);
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+// A node of a list kept in a heap file, linked by offsets
+struct file_node {
+    uint64_t next;
+    char name[24];
+};
+
+static MunitResult test_file(const MunitParameter params[], void *fixture) {
+    size_t heap_size = (size_t)1 << 20;
+    size_t alignment = tiny_block_size();
+    size_t node_blocks = OBJ_BLOCKS(struct file_node, alignment);
+    char path[] = "/tmp/tiny-test-XXXXXX";
+    int fd = mkstemp(path);
+    assert_int(fd, >=, 0);
+    close(fd);
+
+    // An empty file gets a new heap
+    assert_true(tiny_open_file(path, heap_size));
+    assert_true(tiny_last_operation().success);
+    assert_null(tiny_root());
+    struct file_node *first = tiny_malloc(sizeof(struct file_node));
+    struct file_node *second = tiny_malloc(sizeof(struct file_node));
+    strcpy(first->name, "first");
+    strcpy(second->name, "second");
+    first->next = tiny_ptr_to_off(second);
+    second->next = tiny_ptr_to_off(NULL);
+    assert_ptr_equal(tiny_off_to_ptr(first->next), second);
+    assert_null(tiny_off_to_ptr(second->next));
+    tiny_set_root(first);
+    tiny_summary before = tiny_inspect();
+    tiny_clear();
+
+    // The heap in the file is reused as it is, wherever it gets mapped
+    assert_true(tiny_open_file(path, 0));
+    ASSERT_HEAP({
+        { true, node_blocks },
+        { true, node_blocks },
+        { false, before.free.blocks }
+    });
+    first = tiny_root();
+    assert_not_null(first);
+    assert_string_equal(first->name, "first");
+    second = tiny_off_to_ptr(first->next);
+    assert_string_equal(second->name, "second");
+    assert_null(tiny_off_to_ptr(second->next));
+    tiny_free(first);
+    tiny_set_root(second);
+    tiny_clear();
+
+    // A broken chain of sections is not taken over, and the file is left as is
+    assert_true(tiny_open_file(path, 0));
+    off_t offset = (off_t)((uintptr_t)tiny_inspect().buffer % (uintptr_t)sysconf(_SC_PAGESIZE));
+    tiny_clear();
+    size_t broken = heap_size, read_back = 0;
+    fd = open(path, O_RDWR);
+    assert_int(fd, >=, 0);
+    assert_int(pwrite(fd, &broken, sizeof(broken), offset), ==, sizeof(broken));
+    close(fd);
+    assert_false(tiny_open_file(path, heap_size));
+    ASSERT_OP(INIT, false, heap_size);
+    fd = open(path, O_RDONLY);
+    assert_int(pread(fd, &read_back, sizeof(read_back), offset), ==, sizeof(read_back));
+    assert_size(read_back, ==, broken);
+    close(fd);
+
+    // Neither is a file that does not hold a heap
+    fd = open(path, O_WRONLY | O_TRUNC);
+    assert_int(write(fd, "not a heap", 10), ==, 10);
+    close(fd);
+    assert_false(tiny_open_file(path, heap_size));
+
+    unlink(path);
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+// Dies while allocating, holding the lock of the shared heap
+static void die_allocating(void *context, void *ptr, size_t size) {
+    _exit(0);
+}
+
+static MunitResult test_shared(const MunitParameter params[], void *fixture) {
+    size_t heap_size = (size_t)1 << 20;
+    size_t alignment = tiny_block_size();
+    size_t node_blocks = OBJ_BLOCKS(struct file_node, alignment);
+    const char *name = "/tiny-test-shared";
+    shm_unlink(name);
+
+    // The process creating the segment initialises the heap
+    assert_true(tiny_open_shared(name, heap_size));
+    struct file_node *first = tiny_malloc(sizeof(struct file_node));
+    strcpy(first->name, "first");
+    first->next = 0;
+    tiny_set_root(first);
+    tiny_summary created = tiny_inspect();
+
+    // Another process attaches to it, at its own address, and adds to it
+    pid_t pid = fork();
+    assert_int(pid, >=, 0);
+    if(pid == 0) {
+        tiny_clear();
+        bool attached = tiny_open_shared(name, 0);
+        struct file_node *root = tiny_root();
+        if(!attached || root == NULL || strcmp(root->name, "first") != 0) {
+            _exit(1);
+        }
+        struct file_node *second = tiny_malloc(sizeof(struct file_node));
+        strcpy(second->name, "second");
+        second->next = 0;
+        root->next = tiny_ptr_to_off(second);
+        _exit(tiny_inspect().sections.taken == 2 ? 0 : 1);
+    }
+    int status;
+    assert_int(waitpid(pid, &status, 0), ==, pid);
+    assert_true(WIFEXITED(status));
+    assert_int(WEXITSTATUS(status), ==, 0);
+
+    // Counters catch up with the changes of other processes on the next call
+    struct file_node *second = tiny_off_to_ptr(first->next);
+    assert_not_null(second);
+    assert_string_equal(second->name, "second");
+    tiny_free(tiny_malloc(1));
+    ASSERT_HEAP({
+        { true, node_blocks },
+        { true, node_blocks },
+        { false, created.free.blocks - node_blocks - OBJ_BLOCKS(size_t, alignment) }
+    });
+
+    // A process that dies holding the lock does not leave it held
+    pid = fork();
+    assert_int(pid, >=, 0);
+    if(pid == 0) {
+        static const tiny_hooks hooks = { .allocate = die_allocating };
+        tiny_set_hooks(&hooks);
+        tiny_malloc(1);
+        _exit(1);
+    }
+    assert_int(waitpid(pid, &status, 0), ==, pid);
+    assert_int(WEXITSTATUS(status), ==, 0);
+    void *third = tiny_malloc(sizeof(struct file_node));
+    assert_not_null(third);
+    assert_size(tiny_inspect().sections.taken, ==, 4);
+
+    // Neither growing nor mapping allocations can be turned on
+    tiny_growth growth = { NULL, NULL, NULL, 0 };
+    tiny_set_growth(&growth);
+    tiny_set_mmap_threshold(1);
+    assert_null(tiny_malloc(heap_size));
+    tiny_free(tiny_malloc(1));
+    assert_size(tiny_statistics().mappings, ==, 0);
+
+    shm_unlink(name);
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_owns(const MunitParameter params[], void *fixture) {
+    static unsigned char buffer[1024];
+    size_t alignment = tiny_block_size();
+    int outside = 0;
+    tiny_init(buffer, sizeof(buffer));
+    unsigned char *obj1 = tiny_malloc(1);
+    unsigned char *obj2 = tiny_malloc(3 * alignment);
+    assert_true(tiny_owns(obj1));
+    assert_true(tiny_owns(obj2));
+    assert_true(tiny_owns(buffer));
+    assert_false(tiny_owns(buffer + sizeof(buffer)));
+    assert_false(tiny_owns(&outside));
+    assert_false(tiny_owns(NULL));
+    assert_size(tiny_usable_size(obj1), ==, alignment);
+    assert_size(tiny_usable_size(obj2), ==, 3 * alignment);
+    assert_size(tiny_usable_size(NULL), ==, 0);
+
+    tiny_clear();
+    assert_false(tiny_owns(obj1));
+
+    // Memory the heap grew by and allocations with their own mapping are
+    // recognised too, unlike memory from other allocators
+    tiny_growth growth = { NULL, NULL, NULL, 65536 };
+    tiny_set_growth(&growth);
+    tiny_set_mmap_threshold(65536);
+    unsigned char *grown = tiny_malloc(2 * sizeof(buffer));
+    unsigned char *mapped = tiny_malloc(65536);
+    assert_true(grown < buffer || grown >= buffer + sizeof(buffer));
+    assert_true(tiny_owns(grown));
+    assert_true(tiny_owns(mapped));
+    unsigned char *foreign = malloc(2 * sizeof(buffer));
+    unsigned char *page = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert_ptr_not_equal(page, MAP_FAILED);
+    memcpy(page, mapped - 2 * tiny_block_size(), 2 * tiny_block_size());
+    assert_false(tiny_owns(foreign));
+    assert_false(tiny_owns(page + 2 * tiny_block_size()));
+    free(foreign);
+    munmap(page, 4096);
+    tiny_free(mapped);
+    tiny_free(grown);
+    tiny_set_mmap_threshold(0);
+    tiny_set_growth(NULL);
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_aligned(const MunitParameter params[], void *fixture) {
+    static unsigned char buffer[1 << 16];
+    tiny_init(buffer, sizeof(buffer));
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+    size_t available_blocks = tiny_inspect().total.blocks;
+
+    // The section is split so that the data of its second part is aligned
+    unsigned char *obj1 = tiny_malloc(1);
+    unsigned char *obj2 = tiny_aligned_alloc(256, 100);
+    assert_not_null(obj2);
+    assert_size((uintptr_t)obj2 % 256, ==, 0);
+    size_t lead = (size_t)(obj2 - obj1) / alignment - 2 * header_blocks - 1;
+    assert_size(lead, >=, 1);
+    size_t obj2_blocks = SIZE_BLOCKS(100, alignment);
+    ASSERT_HEAP({
+        { true, 1 },
+        { false, lead },
+        { true, obj2_blocks },
+        { false, available_blocks - 1 - lead - obj2_blocks - 3 * header_blocks }
+    });
+    unsigned char *obj3 = tiny_aligned_alloc(4096, 4096);
+    assert_size((uintptr_t)obj3 % 4096, ==, 0);
+    memset(obj3, 0xff, 4096);
+    assert_size(tiny_usable_size(obj3), ==, 4096);
+
+    // Small alignments are served as any other allocation
+    unsigned char *obj4 = tiny_aligned_alloc(alignment, 1);
+    assert_ptr_equal(obj4, obj1 + (1 + header_blocks) * alignment);
+
+    // Alignments that are not powers of two are refused
+    assert_null(tiny_aligned_alloc(3 * alignment, 1));
+    ASSERT_OP(MALLOC, false, 1);
+    assert_null(tiny_aligned_alloc(256, sizeof(buffer)));
+
+    tiny_free(obj1);
+    tiny_free(obj2);
+    tiny_free(obj3);
+    tiny_free(obj4);
+    ASSERT_HEAP({ { false, available_blocks } });
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_free_sized(const MunitParameter params[], void *fixture) {
+    static unsigned char buffer[1024];
+    tiny_init(buffer, sizeof(buffer));
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+    size_t available_blocks = tiny_inspect().total.blocks;
+    unsigned char *obj1 = tiny_malloc(3 * alignment);
+    unsigned char *obj2 = tiny_malloc(alignment + 1);
+
+    // Sizes that the section could not have been taken for are refused
+    tiny_free_sized(obj1, 3 * alignment + 1);
+    ASSERT_OP(FREE, false, 3 * alignment + 1);
+    tiny_free_sized(obj1, alignment - header_blocks * alignment);
+    ASSERT_OP(FREE, false, alignment - header_blocks * alignment);
+    ASSERT_HEAP({
+        { true, 3 },
+        { true, 2 },
+        { false, available_blocks - 5 - 2 * header_blocks }
+    });
+
+    tiny_free_sized(obj1, 3 * alignment);
+    ASSERT_OP(FREE, true, 3);
+    tiny_free_sized(obj2, alignment + 1);
+    ASSERT_HEAP({ { false, available_blocks } });
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_contexts(const MunitParameter params[], void *fixture) {
+    static unsigned char buffer[1024], other[1 << 14];
+    tiny_init(buffer, sizeof(buffer));
+    size_t available_blocks = tiny_inspect().total.blocks;
+    unsigned char *obj1 = tiny_malloc(1);
+
+    // Buffers too small to hold a context are refused
+    assert_null(tiny_create(other, 8));
+    assert_null(tiny_create(NULL, sizeof(other)));
+
+    // A created context has a heap of its own, used until switched back
+    tiny_context *context = tiny_create(other, sizeof(other));
+    assert_not_null(context);
+    assert_true(tiny_owns(obj1));
+    tiny_context *previous = tiny_use(context);
+    assert_int(tiny_last_operation().function, ==, TINY_INIT);
+    unsigned char *obj2 = tiny_malloc(1);
+    assert_not_null(obj2);
+    assert_true(obj2 > other && obj2 < other + sizeof(other));
+    assert_false(tiny_owns(obj1));
+    assert_true(tiny_owns(obj2));
+    tiny_free(obj2);
+    assert_ptr_equal(tiny_use(previous), context);
+
+    // The main heap was left as it was
+    assert_true(tiny_owns(obj1));
+    assert_false(tiny_owns(obj2));
+    tiny_free(obj1);
+    ASSERT_HEAP({ { false, available_blocks } });
+
+    // NULL selects the main context
+    tiny_use(context);
+    assert_ptr_equal(tiny_use(NULL), context);
+    assert_true(tiny_owns(buffer));
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_malloc_blocks(const MunitParameter params[], void *fixture) {
+    static unsigned char buffer[1024];
+    tiny_init(buffer, sizeof(buffer));
+    size_t alignment = tiny_block_size();
+    size_t header_blocks = OBJ_BLOCKS(size_t, alignment);
+    size_t available_blocks = tiny_inspect().total.blocks;
+
+    // Sizes rounded beforehand are taken as `tiny_malloc()` takes them
+    unsigned char *obj1 = tiny_malloc_blocks(2, alignment + 1);
+    ASSERT_OP(MALLOC, true, alignment + 1);
+    unsigned char *obj2 = tiny_malloc(alignment + 1);
+    assert_ptr_equal(obj2, obj1 + (2 + header_blocks) * alignment);
+    ASSERT_HEAP({
+        { true, 2 },
+        { true, 2 },
+        { false, available_blocks - 4 - 2 * header_blocks }
+    });
+    assert_null(tiny_malloc_blocks(available_blocks, available_blocks * alignment));
+    ASSERT_OP(MALLOC, false, available_blocks * alignment);
+
+    // They are checked as `tiny_malloc()` checks them
+    assert_null(tiny_malloc_blocks(0, 0));
+    assert_null(tiny_malloc_blocks(1, alignment + 1));
+    assert_null(tiny_malloc_blocks(1, (size_t)-1));
+    ASSERT_OP(MALLOC, false, (size_t)-1);
+    tiny_clear();
+    assert_null(tiny_malloc_blocks(1, 1));
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_zero(const MunitParameter params[], void *fixture) {
+    size_t heap_size = (size_t)1 << 20, obj_size = (size_t)1 << 16;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignment = tiny_block_size();
+    static unsigned char resident[((size_t)1 << 16) / 4096];
+    assert_true(tiny_init_mapped(heap_size, 0));
+
+    // Fresh memory is not cleared, so its pages are not faulted in
+    unsigned char *obj1 = tiny_calloc(1, obj_size);
+    assert_not_null(obj1);
+    unsigned char *interior = (unsigned char *)ALIGN((uintptr_t)obj1 + alignment, page);
+    size_t pages = obj_size / page - 2;
+    assert_size(pages, <=, sizeof(resident));
+    assert_int(mincore(interior, pages * page, resident), ==, 0);
+    for(size_t i = 0; i < pages; i++) {
+        assert_int(resident[i] & 1, ==, 0);
+    }
+    for(size_t i = 0; i < obj_size; i++) {
+        assert_uint8(obj1[i], ==, 0);
+    }
+
+    // Freed memory is cleared, unless zeroed beforehand
+    unsigned char *obj2 = tiny_malloc(obj_size);
+    unsigned char *obj3 = tiny_malloc(1);
+    memset(obj2, 0xff, obj_size);
+    tiny_free(obj2);
+    assert_size(tiny_prezero(obj_size - alignment - 1), ==, 0);
+    assert_size(tiny_prezero(obj_size - alignment), ==, obj_size - alignment);
+    assert_size(tiny_prezero((size_t)-1), ==, 0);
+    obj2 = tiny_calloc(obj_size, 1);
+    for(size_t i = 0; i < obj_size; i++) {
+        assert_uint8(obj2[i], ==, 0);
+    }
+    memset(obj2, 0xff, obj_size);
+    tiny_free(obj2);
+    obj2 = tiny_calloc(obj_size / 4, 4);
+    for(size_t i = 0; i < obj_size; i++) {
+        assert_uint8(obj2[i], ==, 0);
+    }
+
+    // Purging the free sections of a mapped heap leaves them zeroed
+    memset(obj2, 0xff, obj_size);
+    tiny_free(obj2);
+    tiny_free(obj3);
+    tiny_trim(0);
+    assert_size(tiny_prezero((size_t)-1), ==, 0);
+
+    // Growing zeroes the tail past what was used, wherever it is taken from
+    unsigned char *obj4 = tiny_recalloc(NULL, 1, alignment);
+    obj2 = tiny_malloc(4 * alignment);
+    memset(obj2, 0xff, 4 * alignment);
+    tiny_free(obj2);
+    memset(obj4, 0x5a, alignment);
+    assert_ptr_equal(tiny_recalloc(obj4, 2, 2 * alignment), obj4);
+    for(size_t i = 0; i < 4 * alignment; i++) {
+        assert_uint8(obj4[i], ==, i < alignment ? 0x5a : 0);
+    }
+    obj3 = tiny_malloc(1);
+    unsigned char *obj5 = tiny_recalloc(obj4, 1, 2 * obj_size);
+    assert_ptr_not_equal(obj5, obj4);
+    for(size_t i = 0; i < 2 * obj_size; i++) {
+        assert_uint8(obj5[i], ==, i < alignment ? 0x5a : 0);
+    }
+    assert_null(tiny_recalloc(obj5, (size_t)-1, 2));
+    ASSERT_OP(REALLOC, false, 2);
+
+    // Locked pages are not purged, so they are still cleared
+    assert_true(tiny_init_mapped(heap_size, TINY_MAP_LOCK));
+    obj1 = tiny_malloc(4 * obj_size);
+    memset(obj1, 0xab, 4 * obj_size);
+    tiny_free(obj1);
+    assert_size(tiny_trim(0), ==, 0);
+    obj1 = tiny_calloc(1, 4 * obj_size);
+    for(size_t i = 0; i < 4 * obj_size; i++) {
+        assert_uint8(obj1[i], ==, 0);
+    }
+
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+static MunitResult test_stream(const MunitParameter params[], void *fixture) {
+    static unsigned char buffer[1 << 16];
+    size_t alignment = tiny_block_size();
+    tiny_init(buffer, sizeof(buffer));
+
+    // Moved and cleared blocks are the same with cached and streaming stores,
+    // whichever way the sections are aligned
+    size_t thresholds[] = { 0, 64 };
+    for(size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++) {
+        tiny_set_stream_threshold(thresholds[t]);
+        for(size_t blocks = 1; blocks <= 40; blocks++) {
+            unsigned char *obj1 = tiny_malloc(blocks * alignment);
+            unsigned char *obj2 = tiny_malloc(1);
+            for(size_t i = 0; i < blocks * alignment; i++) {
+                obj1[i] = (unsigned char)(i * 7 + blocks);
+            }
+            unsigned char *moved = tiny_realloc(obj1, 2 * blocks * alignment + 1);
+            assert_ptr_not_equal(moved, obj1);
+            for(size_t i = 0; i < blocks * alignment; i++) {
+                assert_uint8(moved[i], ==, (unsigned char)(i * 7 + blocks));
+            }
+            memset(moved, 0xff, 2 * blocks * alignment + 1);
+            tiny_free(moved);
+            unsigned char *zeroed = tiny_calloc(blocks, 2 * alignment);
+            for(size_t i = 0; i < 2 * blocks * alignment; i++) {
+                assert_uint8(zeroed[i], ==, 0);
+            }
+            tiny_free(zeroed);
+            tiny_free(obj2);
+        }
+    }
+
+    tiny_set_stream_threshold((size_t)4 << 20);
+    tiny_reset();
+    return MUNIT_OK;
+}
+
+// Defined in heap.cpp and frames.cpp
+MunitResult test_basic_heap(const MunitParameter params[], void *fixture);
+MunitResult test_frames(const MunitParameter params[], void *fixture);
+
 static MunitTest tests[] = {
     { 
         "/init-clear-reset", 
@@ -316,6 +1489,126 @@ static MunitTest tests[] = {
         test_out_of_memory,
         NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
     },
+    {
+        "/hooks",
+        test_hooks,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/dump",
+        test_dump,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/statistics",
+        test_statistics,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/snapshot",
+        test_snapshot,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/lifetimes",
+        test_lifetimes,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/tags",
+        test_tags,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/growth",
+        test_growth,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/reserved",
+        test_reserved,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/mapped",
+        test_mapped,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/trim",
+        test_trim,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/huge-pages",
+        test_huge_pages,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/prefault",
+        test_prefault,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/numa",
+        test_numa,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/file",
+        test_file,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/shared",
+        test_shared,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/owns",
+        test_owns,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/aligned",
+        test_aligned,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/free-sized",
+        test_free_sized,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/contexts",
+        test_contexts,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/malloc-blocks",
+        test_malloc_blocks,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/zero",
+        test_zero,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/stream",
+        test_stream,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/basic-heap",
+        test_basic_heap,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
+    {
+        "/frames",
+        test_frames,
+        NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL
+    },
     { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
@@ -0,0 +1,120 @@
+#ifndef TINY_FRAMES_HPP
+#define TINY_FRAMES_HPP
+
+#include "tiny-resource.hpp"
+#include <cstddef>
+#include <new>
+
+// Allocates coroutine frames from tiny heaps. Frames come in the few sizes
+// the compiler lays out for each coroutine, so freed frames are kept in a list
+// per size and handed out again, without walking the heap. Meant for C++20
+// coroutines, though the header itself only requires C++17.
+
+namespace tiny {
+
+// Recycles frames taken from a heap. Frames are rounded up to `granularity`
+// bytes and kept in one list per rounded size, up to `max_frame` bytes; larger
+// ones are taken and returned every time. Like the heap it draws from, a pool
+// is not meant to be used by several threads at once.
+class frame_pool {
+public:
+    static constexpr std::size_t granularity = 64;
+    static constexpr std::size_t max_frame = 4096;
+
+    explicit frame_pool(heap_resource &resource = main_resource()) noexcept :
+        resource(&resource), lists() {}
+
+    frame_pool(const frame_pool &) = delete;
+    frame_pool &operator=(const frame_pool &) = delete;
+
+    ~frame_pool() {
+        release();
+    }
+
+    // Takes a frame from the list of its size, or from the heap if empty.
+    // Throws `std::bad_alloc` if the heap has no room for it.
+    void *allocate(std::size_t size) {
+        std::size_t index = list_of(size);
+        if(index < list_count && lists[index] != nullptr) {
+            free_frame *frame = lists[index];
+            lists[index] = frame->next;
+            return frame;
+        }
+        return resource->allocate(index < list_count ? (index + 1) * granularity : size);
+    }
+
+    // Keeps a frame for frames of the same size
+    void deallocate(void *ptr, std::size_t size) noexcept {
+        std::size_t index = list_of(size);
+        if(index < list_count) {
+            lists[index] = new(ptr) free_frame{ lists[index] };
+        } else {
+            resource->deallocate(ptr, size);
+        }
+    }
+
+    // Returns every frame kept to the heap
+    void release() noexcept {
+        for(std::size_t index = 0; index < list_count; index++) {
+            while(lists[index] != nullptr) {
+                free_frame *frame = lists[index];
+                lists[index] = frame->next;
+                resource->deallocate(frame, (index + 1) * granularity);
+            }
+        }
+    }
+
+    // Returns how many frames of some size are kept
+    std::size_t cached(std::size_t size) const noexcept {
+        std::size_t count = 0, index = list_of(size);
+        for(free_frame *frame = index < list_count ? lists[index] : nullptr; frame; frame = frame->next) {
+            count++;
+        }
+        return count;
+    }
+
+    // Returns the pool of the calling thread, which draws from the main heap
+    static frame_pool &local() noexcept {
+        static thread_local frame_pool pool;
+        return pool;
+    }
+
+private:
+    static constexpr std::size_t list_count = max_frame / granularity;
+
+    struct free_frame {
+        free_frame *next;
+    };
+
+    static constexpr std::size_t list_of(std::size_t size) noexcept {
+        return size == 0 ? 0 : (size - 1) / granularity;
+    }
+
+    heap_resource *resource;
+    free_frame *lists[list_count];
+};
+
+// Takes the frame pool of the calling thread
+struct local_frames {
+    static frame_pool &pool() noexcept {
+        return frame_pool::local();
+    }
+};
+
+// A base for promise types that allocates the frames of their coroutines
+// from the pool `Pools::pool()` returns. Frames are returned to the pool of
+// the thread that destroys them.
+template<typename Pools = local_frames>
+struct frame_allocated {
+    static void *operator new(std::size_t size) {
+        return Pools::pool().allocate(size);
+    }
+
+    static void operator delete(void *ptr, std::size_t size) noexcept {
+        Pools::pool().deallocate(ptr, size);
+    }
+};
+
+}
+
+#endif
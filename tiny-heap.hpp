@@ -0,0 +1,239 @@
+#ifndef TINY_HEAP_HPP
+#define TINY_HEAP_HPP
+
+#include <cstddef>
+#include <cstring>
+
+// Heaps configured at compile time. Each instance holds its own storage and
+// lays it out as tiny does: sections of whole blocks, each preceded by a header
+// with its size and whether it is taken, up to a taken end marker of size 0.
+// Every operation is defined here, so that calls can be inlined and the block
+// count of constant sizes computed by the compiler. Requires C++17.
+
+namespace tiny {
+
+// Takes the first free section that is large enough, as tiny does
+struct first_fit {
+    static constexpr bool exhaustive = false;
+};
+
+// Takes the smallest free section that is large enough. This walks the whole
+// heap unless a section fits exactly, but splits fewer large sections.
+struct best_fit {
+    static constexpr bool exhaustive = true;
+};
+
+// A heap of `Capacity` bytes whose sections start on `Alignment` boundaries.
+// Like tiny's functions, it is not meant to be used by several threads at once.
+template<
+    std::size_t Capacity,
+    std::size_t Alignment = alignof(std::max_align_t),
+    typename Policy = first_fit
+>
+class basic_heap {
+    static_assert(
+        Alignment != 0 && (Alignment & (Alignment - 1)) == 0,
+        "The alignment must be a power of two"
+    );
+
+public:
+    // Size of a block, in bytes
+    static constexpr std::size_t block_size = Alignment;
+
+    // How many blocks a section header takes
+    static constexpr std::size_t header_blocks = (sizeof(std::size_t) + Alignment - 1) / Alignment;
+
+    // Size of a section header, in bytes
+    static constexpr std::size_t header_size = header_blocks * Alignment;
+
+    // How many blocks the single free section of an empty heap holds
+    static constexpr std::size_t total_blocks = Capacity / Alignment - 2 * header_blocks;
+
+    static_assert(
+        Capacity / Alignment > 2 * header_blocks,
+        "The capacity must hold a section and the end marker"
+    );
+
+    // Returns how many blocks a section of some size takes
+    static constexpr std::size_t blocks_for(std::size_t size) noexcept {
+        return size / Alignment + (size % Alignment != 0);
+    }
+
+    basic_heap() noexcept {
+        clear();
+    }
+
+    basic_heap(const basic_heap &) = delete;
+    basic_heap &operator=(const basic_heap &) = delete;
+
+    // Frees every section at once
+    void clear() noexcept {
+        write(0, total_blocks, false);
+        write(header_blocks + total_blocks, 0, true);
+    }
+
+    // Allocates `size` bytes. Returns nullptr when `size` is 0 or no free
+    // section is large enough.
+    void *malloc(std::size_t size) noexcept {
+        if(size == 0 || size > total_blocks * Alignment) {
+            return nullptr;
+        }
+        std::size_t blocks = blocks_for(size);
+        std::size_t chosen = npos, chosen_blocks = 0;
+        for(std::size_t header = 0; ; ) {
+            std::size_t word = read(header);
+            std::size_t length = word & size_mask;
+            if(word == taken_bit) {
+                break;
+            }
+            if(!(word & taken_bit)) {
+                length = join_free(header, length);
+                if(length >= blocks && (chosen == npos || length < chosen_blocks)) {
+                    chosen = header;
+                    chosen_blocks = length;
+                    if(!Policy::exhaustive || length == blocks) {
+                        break;
+                    }
+                }
+            }
+            header += header_blocks + length;
+        }
+        if(chosen == npos) {
+            return nullptr;
+        }
+        take(chosen, chosen_blocks, blocks);
+        return data(chosen);
+    }
+
+    // Allocates `count` objects of `size` bytes, zeroed
+    void *calloc(std::size_t count, std::size_t size) noexcept {
+        if(size != 0 && count > static_cast<std::size_t>(-1) / size) {
+            return nullptr;
+        }
+        void *ptr = malloc(count * size);
+        if(ptr != nullptr) {
+            std::memset(ptr, 0, count * size);
+        }
+        return ptr;
+    }
+
+    // Resizes a section, in place if the free sections after it allow.
+    // Otherwise, moves it, unless no free section is large enough, in which
+    // case it is left as it was and nullptr is returned.
+    void *realloc(void *ptr, std::size_t size) noexcept {
+        if(ptr == nullptr) {
+            return malloc(size);
+        }
+        if(size == 0 || size > total_blocks * Alignment) {
+            return nullptr;
+        }
+        std::size_t blocks = blocks_for(size);
+        std::size_t header = header_of(ptr);
+        std::size_t length = read(header) & size_mask;
+        std::size_t next = header + header_blocks + length;
+        std::size_t next_word = read(next);
+        if(!(next_word & taken_bit)) {
+            std::size_t available = length + header_blocks + join_free(next, next_word);
+            if(available >= blocks) {
+                take(header, available, blocks);
+                return ptr;
+            }
+        } else if(length >= blocks) {
+            take(header, length, blocks);
+            return ptr;
+        }
+
+        void *moved = malloc(size);
+        if(moved != nullptr) {
+            std::memcpy(moved, ptr, (length < blocks ? length : blocks) * Alignment);
+            free(ptr);
+        }
+        return moved;
+    }
+
+    // Frees a section, joining it with the free sections after it
+    void free(void *ptr) noexcept {
+        if(ptr == nullptr) {
+            return;
+        }
+        std::size_t header = header_of(ptr);
+        std::size_t length = read(header) & size_mask;
+        std::size_t next = header + header_blocks + length;
+        std::size_t next_word = read(next);
+        if(!(next_word & taken_bit)) {
+            length += header_blocks + join_free(next, next_word);
+        }
+        write(header, length, false);
+    }
+
+    // Returns whether memory lies in this heap
+    bool owns(const void *ptr) const noexcept {
+        const unsigned char *address = static_cast<const unsigned char *>(ptr);
+        return address >= storage && address < storage + sizeof(storage);
+    }
+
+    // Returns how many bytes a section holds
+    std::size_t usable_size(const void *ptr) const noexcept {
+        return ptr == nullptr ? 0 : (read(header_of(ptr)) & size_mask) * Alignment;
+    }
+
+private:
+    static constexpr std::size_t taken_bit = ~(static_cast<std::size_t>(-1) >> 1);
+    static constexpr std::size_t size_mask = ~taken_bit;
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Headers are addressed by block index and copied in and out, so that
+    // alignments smaller than a size_t's are supported
+    std::size_t read(std::size_t header) const noexcept {
+        std::size_t word;
+        std::memcpy(&word, storage + header * Alignment, sizeof(word));
+        return word;
+    }
+
+    void write(std::size_t header, std::size_t length, bool taken) noexcept {
+        std::size_t word = length | (taken ? taken_bit : 0);
+        std::memcpy(storage + header * Alignment, &word, sizeof(word));
+    }
+
+    std::size_t header_of(const void *ptr) const noexcept {
+        return static_cast<std::size_t>(static_cast<const unsigned char *>(ptr) - storage) /
+            Alignment - header_blocks;
+    }
+
+    void *data(std::size_t header) noexcept {
+        return storage + (header + header_blocks) * Alignment;
+    }
+
+    // Joins a free section with the free sections after it. Returns its length.
+    std::size_t join_free(std::size_t header, std::size_t length) noexcept {
+        std::size_t next = header + header_blocks + (length & size_mask);
+        std::size_t word = read(next);
+        std::size_t joined = length & size_mask;
+        while(!(word & taken_bit)) {
+            joined += header_blocks + word;
+            next += header_blocks + word;
+            word = read(next);
+        }
+        if(joined != (length & size_mask)) {
+            write(header, joined, false);
+        }
+        return joined;
+    }
+
+    // Takes `blocks` of a section of `length` blocks, leaving the rest free
+    // when it can hold a header and a block
+    void take(std::size_t header, std::size_t length, std::size_t blocks) noexcept {
+        if(length - blocks <= header_blocks) {
+            write(header, length, true);
+        } else {
+            write(header, blocks, true);
+            write(header + header_blocks + blocks, length - blocks - header_blocks, false);
+        }
+    }
+
+    alignas(Alignment) unsigned char storage[Capacity / Alignment * Alignment];
+};
+
+}
+
+#endif
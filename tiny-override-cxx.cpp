@@ -0,0 +1,128 @@
+#include "tiny.h"
+#include <cstddef>
+#include <new>
+
+// Replaces every global `operator new` and `operator delete` with tiny's
+// allocation functions. Sized deletes check the size against the section
+// freed, and aligned news take aligned sections.
+
+// Allocates memory as `operator new` must: retrying after calling the new
+// handler, if installed, and throwing `std::bad_alloc` otherwise
+static void *allocate(std::size_t size, std::size_t alignment) {
+    for(;;) {
+        void *data = alignment != 0 ?
+            tiny_aligned_alloc(alignment, size != 0 ? size : 1) :
+            tiny_malloc(size != 0 ? size : 1);
+        if(data != nullptr) {
+            return data;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void *allocate(std::size_t size, std::size_t alignment, const std::nothrow_t &) noexcept {
+    try {
+        return allocate(size, alignment);
+    } catch(const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+// Frees memory as `free()` does when `tiny-override.c` is linked along, so that
+// memory it retired or, in hybrid builds, handed to the next allocator is
+// not given to `tiny_free()`. Otherwise, everything allocated is tiny's.
+extern "C" __attribute__((weak)) void tiny_override_free(void *ptr, std::size_t size);
+
+static void release(void *ptr, std::size_t size) noexcept {
+    if(tiny_override_free != nullptr) {
+        tiny_override_free(ptr, size);
+    } else if(size != 0) {
+        tiny_free_sized(ptr, size);
+    } else {
+        tiny_free(ptr);
+    }
+}
+
+void *operator new(std::size_t size) {
+    return allocate(size, 0);
+}
+
+void *operator new[](std::size_t size) {
+    return allocate(size, 0);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &nothrow) noexcept {
+    return allocate(size, 0, nothrow);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &nothrow) noexcept {
+    return allocate(size, 0, nothrow);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &nothrow) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment), nothrow);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &nothrow) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment), nothrow);
+}
+
+void operator delete(void *ptr) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete[](void *ptr) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete(void *ptr, std::size_t size) noexcept {
+    release(ptr, size != 0 ? size : 1);
+}
+
+void operator delete[](void *ptr, std::size_t size) noexcept {
+    release(ptr, size != 0 ? size : 1);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    release(ptr, 0);
+}
+
+void operator delete(void *ptr, std::size_t size, std::align_val_t) noexcept {
+    release(ptr, size != 0 ? size : 1);
+}
+
+void operator delete[](void *ptr, std::size_t size, std::align_val_t) noexcept {
+    release(ptr, size != 0 ? size : 1);
+}
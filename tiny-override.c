@@ -1,10 +1,238 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "tiny.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TINY_CONF_ENV 1
+#include <unistd.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#if __GLIBC__ > 2 || __GLIBC_MINOR__ >= 33
+#define TINY_MALLINFO2 1
+#endif
+#endif
+
+// Memory allocated from the static buffer before `TINY_CONF` set up another
+// heap. It is never reused, so freeing it does nothing.
+static unsigned char *retired, *retired_end;
+
+static bool is_retired(const void *ptr) {
+    const unsigned char *address = ptr;
+    return address >= retired && address < retired_end;
+}
+
+// Moves memory allocated from the static buffer to the current heap
+static void *move_retired(void *ptr, size_t size) {
+    void *data = size != 0 ? malloc(size) : NULL;
+    if(data != NULL) {
+        size_t old_size = tiny_usable_size(ptr);
+        memcpy(data, ptr, old_size < size ? old_size : size);
+    }
+    return data;
+}
+
+// Frees memory for `free()` and for the C++ deletes, which call it when built
+// along, so that retired memory and, in hybrid builds, memory of the next
+// allocator are told apart the same way. Sized deletes pass the size they
+// know of, and everything else 0.
+void tiny_override_free(void *ptr, size_t size);
+
+#ifdef TINY_HYBRID
+// Serves small requests from tiny and everything else, including whatever tiny
+// cannot serve, from the next allocator in line, usually the stdlib's.
+#include <dlfcn.h>
+
+// Requests up to this many bytes are served by tiny
+#ifndef TINY_HYBRID_THRESHOLD
+#define TINY_HYBRID_THRESHOLD 1024
+#endif
+static size_t hybrid_threshold = TINY_HYBRID_THRESHOLD;
+
+// The functions of the next allocator in line
+static struct next_allocator {
+    void *(*malloc)(size_t);
+    void *(*realloc)(void *, size_t);
+    void *(*calloc)(size_t, size_t);
+    void (*free)(void *);
+    int (*malloc_trim)(size_t);
+    void *(*memalign)(size_t, size_t);
+    size_t (*malloc_usable_size)(void *);
+    int (*mallopt)(int, int);
+    #ifdef TINY_MALLINFO2
+    struct mallinfo2 (*mallinfo2)(void);
+    #endif
+} next;
+
+// Whether the next allocator is being looked up. `dlsym()` may allocate while
+// at it, which tiny must serve on its own.
+static bool resolving;
+
+// Looks up a function of the next allocator. ISO C does not convert the object
+// pointer `dlsym()` returns to a function pointer, so it is copied instead.
+static void look_up(void *function, const char *name) {
+    void *symbol = dlsym(RTLD_NEXT, name);
+    memcpy(function, &symbol, sizeof(symbol));
+}
+
+static bool resolve(void) {
+    if(next.free != NULL) {
+        return true;
+    }
+    if(resolving) {
+        return false;
+    }
+    resolving = true;
+    look_up(&next.malloc, "malloc");
+    look_up(&next.realloc, "realloc");
+    look_up(&next.calloc, "calloc");
+    look_up(&next.malloc_trim, "malloc_trim");
+    look_up(&next.memalign, "memalign");
+    look_up(&next.malloc_usable_size, "malloc_usable_size");
+    look_up(&next.mallopt, "mallopt");
+    #ifdef TINY_MALLINFO2
+    look_up(&next.mallinfo2, "mallinfo2");
+    #endif
+    look_up(&next.free, "free");
+    resolving = false;
+    return next.free != NULL;
+}
 
+void *malloc(size_t size) {
+    if(size <= hybrid_threshold) {
+        void *data = tiny_malloc(size);
+        if(data != NULL) {
+            return data;
+        }
+    }
+    return resolve() ? next.malloc(size) : NULL;
+}
+
+void *realloc(void *ptr, size_t size) {
+    if(ptr == NULL) {
+        return malloc(size);
+    }
+    if(is_retired(ptr)) {
+        return move_retired(ptr, size);
+    }
+    if(!tiny_owns(ptr)) {
+        return resolve() ? next.realloc(ptr, size) : NULL;
+    }
+    if(size == 0) {
+        tiny_free(ptr);
+        return NULL;
+    }
+    if(size <= hybrid_threshold) {
+        void *data = tiny_realloc(ptr, size);
+        if(data != NULL) {
+            return data;
+        }
+    }
+    // Moves the memory out of tiny
+    void *data = resolve() ? next.malloc(size) : NULL;
+    if(data != NULL) {
+        size_t old_size = tiny_usable_size(ptr);
+        memcpy(data, ptr, old_size < size ? old_size : size);
+        tiny_free(ptr);
+    }
+    return data;
+}
+
+void *calloc(size_t num, size_t size) {
+    if(size != 0 && num <= hybrid_threshold / size) {
+        void *data = tiny_calloc(num, size);
+        if(data != NULL) {
+            return data;
+        }
+    }
+    return resolve() ? next.calloc(num, size) : NULL;
+}
+
+void tiny_override_free(void *ptr, size_t size) {
+    if(is_retired(ptr)) {
+        return;
+    }
+    if(!tiny_owns(ptr)) {
+        if(ptr != NULL && resolve()) {
+            next.free(ptr);
+        }
+    } else if(size != 0) {
+        tiny_free_sized(ptr, size);
+    } else {
+        tiny_free(ptr);
+    }
+}
+
+void free(void *ptr) {
+    tiny_override_free(ptr, 0);
+}
+
+int malloc_trim(size_t pad) {
+    int trimmed = tiny_trim(pad) > 0;
+    if(resolve() && next.malloc_trim != NULL) {
+        trimmed |= next.malloc_trim(pad);
+    }
+    return trimmed;
+}
+
+static void *allocate_aligned(size_t alignment, size_t size) {
+    if(size <= hybrid_threshold) {
+        void *data = tiny_aligned_alloc(alignment, size);
+        if(data != NULL) {
+            return data;
+        }
+    }
+    return resolve() && next.memalign != NULL ? next.memalign(alignment, size) : NULL;
+}
+
+size_t malloc_usable_size(void *ptr) {
+    if(tiny_owns(ptr) || is_retired(ptr)) {
+        return tiny_usable_size(ptr);
+    }
+    return ptr != NULL && resolve() && next.malloc_usable_size != NULL ? 
+        next.malloc_usable_size(ptr) : 0;
+}
+
+// Tunes the next allocator in line as well
+static int tune_next(int param, int value) {
+    return resolve() && next.mallopt != NULL ? next.mallopt(param, value) : 0;
+}
+
+#ifdef TINY_MALLINFO2
+// Adds what the next allocator in line reports
+static struct mallinfo2 next_info(struct mallinfo2 info) {
+    if(resolve() && next.mallinfo2 != NULL) {
+        struct mallinfo2 other = next.mallinfo2();
+        info.arena += other.arena;
+        info.ordblks += other.ordblks;
+        info.smblks += other.smblks;
+        info.hblks += other.hblks;
+        info.hblkhd += other.hblkhd;
+        info.usmblks += other.usmblks;
+        info.fsmblks += other.fsmblks;
+        info.uordblks += other.uordblks;
+        info.fordblks += other.fordblks;
+        info.keepcost += other.keepcost;
+    }
+    return info;
+}
+#endif
+#else
 void *malloc(size_t size) {
     return tiny_malloc(size);
 }
 
 void *realloc(void *ptr, size_t size) {
+    if(is_retired(ptr)) {
+        return move_retired(ptr, size);
+    }
     return tiny_realloc(ptr, size);
 }
 
@@ -12,6 +240,424 @@ void *calloc(size_t num, size_t size) {
     return tiny_calloc(num, size);
 }
 
+void tiny_override_free(void *ptr, size_t size) {
+    if(is_retired(ptr)) {
+        return;
+    }
+    if(size != 0) {
+        tiny_free_sized(ptr, size);
+    } else {
+        tiny_free(ptr);
+    }
+}
+
 void free(void *ptr) {
-    tiny_free(ptr);
-}
\ No newline at end of file
+    tiny_override_free(ptr, 0);
+}
+
+int malloc_trim(size_t pad) {
+    return tiny_trim(pad) > 0;
+}
+
+static void *allocate_aligned(size_t alignment, size_t size) {
+    return tiny_aligned_alloc(alignment, size);
+}
+
+size_t malloc_usable_size(void *ptr) {
+    return tiny_usable_size(ptr);
+}
+
+static int tune_next(int param, int value) {
+    (void)param;
+    (void)value;
+    return 0;
+}
+
+#ifdef TINY_MALLINFO2
+static struct mallinfo2 next_info(struct mallinfo2 info) {
+    return info;
+}
+#endif
+#endif
+
+static size_t page_size(void) {
+    #ifdef TINY_CONF_ENV
+    return (size_t)sysconf(_SC_PAGESIZE);
+    #else
+    return 4096;
+    #endif
+}
+
+void *memalign(size_t alignment, size_t size) {
+    return allocate_aligned(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return allocate_aligned(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    if(alignment == 0 || alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *data = allocate_aligned(alignment, size);
+    if(data == NULL && size != 0) {
+        return ENOMEM;
+    }
+    *ptr = data;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    return allocate_aligned(page_size(), size);
+}
+
+void *pvalloc(size_t size) {
+    size_t page = page_size();
+    size_t rounded = (size + page - 1) & ~(page - 1);
+    if(rounded < size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return allocate_aligned(page, rounded != 0 ? rounded : page);
+}
+
+void *reallocarray(void *ptr, size_t num, size_t size) {
+    if(size != 0 && num > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(ptr, num * size);
+}
+
+// Tuning set through `mallopt()`, which tiny takes all at once
+static size_t trim_threshold, top_pad;
+
+// Maps the parameters of the stdlib's allocator to tiny's own. Parameters that
+// have no counterpart are accepted and ignored. In hybrid builds, mapping
+// parameters only tune the next allocator, which serves large requests.
+int mallopt(int param, int value) {
+    if(value < 0) {
+        return 0;
+    }
+    switch(param) {
+        #ifdef M_MMAP_THRESHOLD
+        #ifndef TINY_HYBRID
+        case M_MMAP_THRESHOLD:
+            tiny_set_mmap_threshold((size_t)value);
+            break;
+        case M_MMAP_MAX:
+            if(value == 0) {
+                tiny_set_mmap_threshold(0);
+            }
+            break;
+        #endif
+        case M_TRIM_THRESHOLD:
+            // The stdlib's allocator trims whatever is past the threshold, so
+            // 0 trims always
+            trim_threshold = value != 0 ? (size_t)value : 1;
+            tiny_set_trim_threshold(trim_threshold, top_pad);
+            break;
+        case M_TOP_PAD:
+            top_pad = (size_t)value;
+            tiny_set_trim_threshold(trim_threshold, top_pad);
+            break;
+        case M_MXFAST:
+        case M_CHECK_ACTION:
+        case M_PERTURB:
+        case M_ARENA_TEST:
+        case M_ARENA_MAX:
+            break;
+        #endif
+        default:
+            return tune_next(param, value);
+    }
+    tune_next(param, value);
+    return 1;
+}
+
+#ifdef TINY_MALLINFO2
+// Reports the running statistics of tiny. The heap is the arena, allocations
+// with their own mapping are mapped blocks and the largest free section is
+// what could be released.
+struct mallinfo2 mallinfo2(void) {
+    tiny_stats stats = tiny_statistics();
+    struct mallinfo2 info = {
+        .arena = stats.free.bytes + stats.taken.bytes,
+        .ordblks = stats.sections.free,
+        .hblks = stats.mappings,
+        .hblkhd = stats.mapped.bytes,
+        .usmblks = stats.peak.bytes,
+        .uordblks = stats.taken.bytes,
+        .fordblks = stats.free.bytes,
+        .keepcost = stats.largest_free.bytes
+    };
+    return next_info(info);
+}
+#endif
+
+#ifdef TINY_CONF_ENV
+// Configures the library from the `TINY_CONF` environment variable before the
+// program starts, without allocating. It holds comma separated options, e.g.
+// `TINY_CONF=size=64M,heap=reserved,decay=1000,stats=/tiny`.
+
+// Options read from `TINY_CONF`
+static struct tiny_conf {
+    size_t size; // Size of the heap to set up, none if 0
+    enum { HEAP_MAPPED, HEAP_RESERVED, HEAP_NUMA } heap; // How the heap is placed
+    unsigned map_flags; // How the heap is mapped
+    size_t grow; // Increment the heap grows by, if not 0
+    size_t mmap_threshold; // Allocations this big get their own mapping
+    size_t decay; // How long free memory stays before being purged, in ms
+    char stats[256]; // Name statistics are published under, if any
+    int trace; // File descriptor events are traced to, if not negative
+} conf = { .trace = -1 };
+
+// Describes an option of `TINY_CONF`
+typedef struct conf_option {
+    const char *key;
+    size_t key_length;
+    const char *value; // NULL for options with no value
+    size_t value_length;
+} conf_option;
+
+static bool option_is(const conf_option *option, const char *key) {
+    return option->key_length == strlen(key) && memcmp(option->key, key, option->key_length) == 0;
+}
+
+static bool value_is(const conf_option *option, const char *value) {
+    return option->value != NULL && option->value_length == strlen(value) &&
+        memcmp(option->value, value, option->value_length) == 0;
+}
+
+// Parses a number with an optional K, M or G suffix
+static bool parse_size(const conf_option *option, size_t *size) {
+    const char *value = option->value;
+    size_t length = option->value != NULL ? option->value_length : 0;
+    size_t result = 0, i = 0;
+    for(; i < length && value[i] >= '0' && value[i] <= '9'; i++) {
+        if(result > (SIZE_MAX - 9) / 10) {
+            return false;
+        }
+        result = result * 10 + (size_t)(value[i] - '0');
+    }
+    unsigned shift = 0;
+    if(i + 1 == length) {
+        switch(value[i] | 0x20) {
+            case 'k': shift = 10; break;
+            case 'm': shift = 20; break;
+            case 'g': shift = 30; break;
+            default: return false;
+        }
+    } else if(i != length) {
+        return false;
+    }
+    if(i == 0 || result > SIZE_MAX >> shift) {
+        return false;
+    }
+    *size = result << shift;
+    return true;
+}
+
+static void report(const char *message, const char *detail, size_t detail_length) {
+    if(
+        write(STDERR_FILENO, message, strlen(message)) < 0 ||
+        write(STDERR_FILENO, detail, detail_length) < 0 ||
+        write(STDERR_FILENO, "\n", 1) < 0
+    ) {
+        return;
+    }
+}
+
+// Applies an option to `conf`. Returns whether it is valid.
+static bool read_option(const conf_option *option) {
+    size_t value = 0;
+    if(option_is(option, "size")) {
+        return parse_size(option, &conf.size);
+    } else if(option_is(option, "heap")) {
+        if(value_is(option, "mapped")) {
+            conf.heap = HEAP_MAPPED;
+        } else if(value_is(option, "reserved")) {
+            conf.heap = HEAP_RESERVED;
+        } else if(value_is(option, "numa")) {
+            conf.heap = HEAP_NUMA;
+        } else {
+            return false;
+        }
+        return true;
+    } else if(option_is(option, "hugetlb") && option->value == NULL) {
+        conf.map_flags |= TINY_MAP_HUGETLB;
+    } else if(option_is(option, "thp") && option->value == NULL) {
+        conf.map_flags |= TINY_MAP_HUGEPAGE;
+    } else if(option_is(option, "populate") && option->value == NULL) {
+        conf.map_flags |= TINY_MAP_POPULATE;
+    } else if(option_is(option, "lock") && option->value == NULL) {
+        conf.map_flags |= TINY_MAP_LOCK;
+    } else if(option_is(option, "grow")) {
+        return parse_size(option, &conf.grow) && conf.grow != 0;
+    } else if(option_is(option, "mmap_threshold")) {
+        #ifdef TINY_HYBRID
+        // Requests large enough to deserve a mapping are the next allocator's
+        return false;
+        #else
+        return parse_size(option, &conf.mmap_threshold);
+        #endif
+    } else if(option_is(option, "decay")) {
+        return parse_size(option, &conf.decay) && conf.decay <= UINT32_MAX;
+    } else if(option_is(option, "stats")) {
+        if(option->value == NULL || option->value_length >= sizeof(conf.stats)) {
+            return false;
+        }
+        memcpy(conf.stats, option->value, option->value_length);
+        conf.stats[option->value_length] = '\0';
+    } else if(option_is(option, "trace")) {
+        if(option->value == NULL) {
+            conf.trace = STDERR_FILENO;
+        } else if(parse_size(option, &value) && value <= INT16_MAX) {
+            conf.trace = (int)value;
+        } else {
+            return false;
+        }
+    #ifdef TINY_HYBRID
+    } else if(option_is(option, "threshold")) {
+        return parse_size(option, &hybrid_threshold);
+    #endif
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Appends a string to a line being traced
+static size_t append_string(char *line, size_t length, const char *str) {
+    while(*str) {
+        line[length++] = *str++;
+    }
+    return length;
+}
+
+// Appends a number to a line being traced, in some base
+static size_t append_number(char *line, size_t length, uintmax_t value, unsigned base) {
+    char digits[sizeof(uintmax_t) * 8];
+    size_t count = 0;
+    do {
+        digits[count++] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while(value != 0);
+    if(base == 16) {
+        length = append_string(line, length, "0x");
+    }
+    while(count > 0) {
+        line[length++] = digits[--count];
+    }
+    return length;
+}
+
+// Traces an event on some memory, and where it went if it moved
+static void trace(const char *event, const void *ptr, const void *new_ptr, size_t size) {
+    char line[128];
+    size_t length = append_string(line, 0, event);
+    line[length++] = ' ';
+    length = append_number(line, length, (uintptr_t)ptr, 16);
+    if(new_ptr != NULL) {
+        line[length++] = ' ';
+        length = append_number(line, length, (uintptr_t)new_ptr, 16);
+    }
+    line[length++] = ' ';
+    length = append_number(line, length, size, 10);
+    line[length++] = '\n';
+    if(write(conf.trace, line, length) < 0) {
+        conf.trace = -1;
+    }
+}
+
+static void trace_allocate(void *context, void *ptr, size_t size) {
+    (void)context;
+    trace("malloc", ptr, NULL, size);
+}
+
+static void trace_free(void *context, void *ptr, size_t size) {
+    (void)context;
+    trace("free", ptr, NULL, size);
+}
+
+static void trace_realloc(void *context, void *old_ptr, size_t old_size, void *new_ptr, size_t size) {
+    (void)context;
+    (void)old_size;
+    trace("realloc", old_ptr, new_ptr, size);
+}
+
+static void trace_out_of_memory(void *context, enum tiny_function function, size_t size) {
+    (void)context;
+    (void)function;
+    trace("out-of-memory", NULL, NULL, size);
+}
+
+static const tiny_hooks trace_hooks = {
+    .allocate = trace_allocate,
+    .free = trace_free,
+    .realloc = trace_realloc,
+    .out_of_memory = trace_out_of_memory
+};
+
+// Sets up the heap `TINY_CONF` asks for. Memory already allocated from the
+// static buffer is retired.
+static bool set_up_heap(void) {
+    tiny_summary summary = tiny_inspect();
+    bool initialised =
+        conf.heap == HEAP_RESERVED ? tiny_init_reserved(conf.size) :
+        conf.heap == HEAP_NUMA ? tiny_init_numa(conf.size, conf.map_flags) :
+        tiny_init_mapped(conf.size, conf.map_flags);
+    if(initialised && summary.static_buffer != NULL) {
+        retired = summary.static_buffer;
+        retired_end = retired + summary.static_buffer_size;
+    }
+    if(initialised && conf.heap == HEAP_NUMA) {
+        tiny_set_numa_routing(true);
+    }
+    return initialised;
+}
+
+__attribute__((constructor))
+static void configure(void) {
+    const char *env = getenv("TINY_CONF");
+    if(env == NULL) {
+        return;
+    }
+    while(*env != '\0') {
+        const char *end = env, *equals = NULL;
+        for(; *end != '\0' && *end != ','; end++) {
+            if(*end == '=' && equals == NULL) {
+                equals = end;
+            }
+        }
+        conf_option option = {
+            env, (size_t)((equals ? equals : end) - env),
+            equals ? equals + 1 : NULL, equals ? (size_t)(end - equals - 1) : 0
+        };
+        if(option.key_length > 0 && !read_option(&option)) {
+            report("tiny: ignoring TINY_CONF option ", env, (size_t)(end - env));
+        }
+        env = *end == ',' ? end + 1 : end;
+    }
+
+    // These are shared by the heaps of every NUMA node when they are set up
+    tiny_set_mmap_threshold(conf.mmap_threshold);
+    if(conf.decay != 0) {
+        tiny_set_decay((uint32_t)conf.decay);
+    }
+    if(conf.trace >= 0) {
+        tiny_set_hooks(&trace_hooks);
+    }
+    if(conf.size != 0 && !set_up_heap()) {
+        report("tiny: TINY_CONF heap could not be set up", "", 0);
+    }
+    if(conf.grow != 0) {
+        tiny_growth growth = { NULL, NULL, NULL, conf.grow };
+        tiny_set_growth(&growth);
+    }
+    if(conf.stats[0] != '\0' && !tiny_publish(conf.stats)) {
+        report("tiny: TINY_CONF statistics could not be published as ", conf.stats, strlen(conf.stats));
+    }
+}
+#endif
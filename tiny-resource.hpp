@@ -0,0 +1,130 @@
+#ifndef TINY_RESOURCE_HPP
+#define TINY_RESOURCE_HPP
+
+#include "tiny.h"
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+// Adapts tiny heaps to standard C++ allocation interfaces. Requires C++17.
+
+namespace tiny {
+
+// A memory resource that takes memory from one tiny heap. It operates on
+// that heap only for the duration of each call, so any thread may use it,
+// though not concurrently with others using the same heap.
+class heap_resource : public std::pmr::memory_resource {
+public:
+    // Wraps an existing context, or the main one if null
+    explicit heap_resource(tiny_context *context = nullptr) noexcept :
+        context(context), owned(false) {}
+
+    // Creates a heap of its own in a buffer, which must outlive the resource.
+    // Throws `std::bad_alloc` if the buffer is too small to hold one. Like any
+    // context, the heap follows its own mmap threshold, `TINY_MMAP_THRESHOLD`
+    // at first, and the growth set while it is in use, so large or excess
+    // allocations may still be served from outside the buffer.
+    heap_resource(void *buffer, std::size_t size) :
+        context(tiny_create(static_cast<unsigned char *>(buffer), size)), owned(true) {
+        if(context == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    heap_resource(const heap_resource &) = delete;
+    heap_resource &operator=(const heap_resource &) = delete;
+
+    // Returns to the system whatever the heap it created took from it
+    ~heap_resource() override {
+        if(owned) {
+            scope use(context);
+            tiny_clear();
+        }
+    }
+
+    tiny_context *heap() const noexcept {
+        return context;
+    }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        scope use(context);
+        void *ptr = tiny_aligned_alloc(alignment, bytes ? bytes : 1);
+        if(ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t) override {
+        scope use(context);
+        tiny_free_sized(ptr, bytes ? bytes : 1);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        const heap_resource *resource = dynamic_cast<const heap_resource *>(&other);
+        return resource != nullptr && resource->context == context;
+    }
+
+private:
+    // Makes the calling thread operate on a context until it goes out of scope
+    struct scope {
+        explicit scope(tiny_context *context) noexcept : previous(tiny_use(context)) {}
+        ~scope() {
+            tiny_use(previous);
+        }
+        tiny_context *previous;
+    };
+
+    tiny_context *context;
+    bool owned;
+};
+
+// Returns a resource that takes memory from the main heap
+inline heap_resource &main_resource() noexcept {
+    static heap_resource resource;
+    return resource;
+}
+
+// An allocator that takes memory from a tiny heap, through a resource that
+// must outlive it. Allocators compare equal when they share a heap.
+template<typename T>
+class allocator {
+public:
+    using value_type = T;
+
+    allocator() noexcept : resource(&main_resource()) {}
+    allocator(heap_resource &resource) noexcept : resource(&resource) {}
+    template<typename U>
+    allocator(const allocator<U> &other) noexcept : resource(other.resource) {}
+
+    T *allocate(std::size_t count) {
+        if(count > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T *>(resource->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t count) noexcept {
+        resource->deallocate(ptr, count * sizeof(T), alignof(T));
+    }
+
+    template<typename U>
+    bool operator==(const allocator<U> &other) const noexcept {
+        return resource->is_equal(*other.resource);
+    }
+
+    template<typename U>
+    bool operator!=(const allocator<U> &other) const noexcept {
+        return !(*this == other);
+    }
+
+private:
+    template<typename U> friend class allocator;
+
+    heap_resource *resource;
+};
+
+}
+
+#endif
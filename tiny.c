@@ -1,7 +1,28 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "tiny.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdatomic.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TINY_POSIX 1
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#define TINY_SHARED 1
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
 
 // Casts a size_t to its closest aligned size
 #define ALIGN_SIZE(size) ((size + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
@@ -29,6 +50,63 @@ enum { HEADER_BLOCKS = ALIGN_SIZE(sizeof(size_t)) / ALIGNMENT };
 // Defines the upper bit of the header as a the taken flag
 #define TAKEN_BIT ((size_t)-1 ^ (((size_t)-1)>>1))
 
+// Defines the bits below the taken flag as the allocation tag
+enum { TAG_BITS = 4 };
+#define TAG_SHIFT (sizeof(size_t) * 8 - 1 - TAG_BITS)
+#define TAG_MASK (((size_t)TINY_TAGS - 1) << TAG_SHIFT)
+
+// Defines the remaining bits as the section size
+#define SIZE_MASK (~(TAKEN_BIT | TAG_MASK))
+
+// Marks a bridge: a header that links the end of a region to the start of the
+// next one, spanning the gap between them. It is read as a taken section, so
+// it is never allocated nor merged.
+#define BRIDGE_BITS TAG_MASK
+
+// Marks the header of an allocation with its own mapping, outside the heap.
+// Its size is the length of the mapping, in bytes, and its tag is kept in the
+// header before it.
+#define MAPPED_BITS ((size_t)1 << TAG_SHIFT)
+
+// Defines how many blocks precede the data of a mapped allocation
+enum { MAPPED_BLOCKS = 2 * HEADER_BLOCKS };
+
+// Marks a free section whose data, past its first block, is known to hold only
+// zeros, so that it need not be cleared when taken by `tiny_calloc()`. Writing
+// the header again drops the mark.
+#define ZERO_BITS ((size_t)2 << TAG_SHIFT)
+
+#ifndef TINY_MMAP_THRESHOLD
+#define TINY_MMAP_THRESHOLD 0
+#endif
+
+#ifndef TINY_STREAM_THRESHOLD
+#define TINY_STREAM_THRESHOLD ((size_t)4 << 20)
+#endif
+
+// Selects the vector kernels that stream blocks past the caches
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TINY_STREAM_X86
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+#define TINY_STREAM_NEON
+#include <arm_neon.h>
+#endif
+
+// Declares a thread-local variable, using the cheapest access model available
+#if defined(__GNUC__) || defined(__clang__)
+#define THREAD_LOCAL _Thread_local __attribute__((tls_model("initial-exec")))
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Hints the compiler that a condition is expected to be false
+#if defined(__GNUC__) || defined(__clang__)
+#define UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define UNLIKELY(x) (x)
+#endif
+
 // Defines blocks as arrays with ALIGNMENT bytes
 typedef unsigned char tiny_block[ALIGNMENT];
 
@@ -60,21 +138,32 @@ static union tiny_aligned_buffer {
 } };
 
 // Initialises the library with the statically allocated buffer
-#define TINY_INITIAL {                                  \
-    (tiny_block *)&tiny_buffer.buffer,                  \
-    (TINY_BUFFER / ALIGNMENT - 2 * HEADER_BLOCKS),      \
-    false,                                              \
-    {                                                   \
-        TINY_LOAD,                                      \
-        true,                                           \
-        (TINY_BUFFER / ALIGNMENT - 2 * HEADER_BLOCKS)   \
-    }                                                   \
+#define TINY_STATIC_BLOCKS (TINY_BUFFER / ALIGNMENT - 2 * HEADER_BLOCKS)
+#define TINY_INITIAL {                                                  \
+    .buffer = (tiny_block *)&tiny_buffer.buffer,                        \
+    .size = TINY_STATIC_BLOCKS,                                         \
+    .last_operation = { TINY_LOAD, true, TINY_STATIC_BLOCKS },          \
+    .base = (unsigned char *)&tiny_buffer,                              \
+    .base_end = (unsigned char *)&tiny_buffer + sizeof(tiny_buffer),    \
+    .mmap_threshold = TINY_MMAP_THRESHOLD,                              \
+    .counters = {                                                       \
+        .free_blocks = TINY_STATIC_BLOCKS,                              \
+        .largest_free = TINY_STATIC_BLOCKS,                             \
+        .sections = { 1, 1, 0 }                                         \
+    }                                                                   \
 }
 #else
 // Initialised the library with no allocated buffer.
-#define TINY_INITIAL { NULL, 0, false, { TINY_LOAD, true, 0 } }
+#define TINY_INITIAL TINY_EMPTY
 #endif
 
+// Initialises a context with no buffer, as the library starts without a static
+// one and as contexts made by `tiny_create()` start
+#define TINY_EMPTY {                                                    \
+    .last_operation = { TINY_LOAD, true, 0 },                           \
+    .mmap_threshold = TINY_MMAP_THRESHOLD                               \
+}
+
 // Map of operations for inspection purpose
 static const char * const operations[] = {         
     "TINY_LOAD",
@@ -93,50 +182,635 @@ typedef struct tiny_block_section {
     size_t size; // Specifies how many blocks are there in this section
     tiny_block *header; // The address of the section header
     void *data; // The address of the section data
+    unsigned tag; // The tag a taken section was allocated with
+    bool bridge; // Whether this is a bridge to another region
+    bool zero; // Whether a free section is known to be zeroed
 } tiny_block_section;
 
-// The main library context
-static struct tiny {
+// Running statistics of a single allocation tag
+typedef struct tiny_tag_counters {
+    size_t live_blocks; // Blocks in taken sections with this tag
+    size_t peak_blocks; // Highest value `live_blocks` has reached
+    size_t allocations; // How many allocations were made with this tag
+} tiny_tag_counters;
+
+// Running statistics, updated incrementally as sections come and go
+typedef struct tiny_counters {
+    size_t free_blocks; // Blocks in free sections
+    size_t taken_blocks; // Blocks in taken sections
+    size_t peak_blocks; // Highest value `taken_blocks` has reached
+    size_t largest_free; // Blocks in the largest free section
+    bool largest_stale; // Whether `largest_free` must be searched again
+    tiny_sections sections; // Section counts
+    size_t operations[TINY_FREE + 1]; // Operation counts, by function
+    size_t failures; // Failed operation count
+    tiny_tag_counters tags[TINY_TAGS]; // Statistics of each allocation tag
+    size_t mapped_blocks; // Blocks in allocations with their own mapping
+    size_t mappings; // Allocations with their own mapping
+} tiny_counters;
+
+#ifndef TINY_GROWN_RANGES
+#define TINY_GROWN_RANGES 32
+#endif
+
+// A range of memory a heap grew by
+typedef struct tiny_grown_range {
+    unsigned char *start;
+    unsigned char *end;
+} tiny_grown_range;
+
+// A library context: a heap and everything about it
+struct tiny_context {
     tiny_block *buffer; // The buffer to operate on
     size_t size;    // The minimum amount of blocks available for allocation
     bool out_of_memory; // Whether should the library fake an out-of-memory situation
     tiny_operation last_operation; // Stores the last operation executed
-} tiny = TINY_INITIAL;
+    const tiny_hooks *hooks; // Event callbacks, NULL when none are installed
+    tiny_counters counters; // Running statistics
+    tiny_stats_page *stats_page; // Shared page statistics are published to
+    unsigned stats_countdown; // Operations left until all statistics are published
+    char stats_name[256]; // Name of the shared memory segment
+    uint64_t *stamps; // Allocation epoch of each taken section, by header block
+    size_t stamp_count; // How many entries `stamps` holds
+    tiny_lifetimes lifetimes; // Lifetime histograms of freed sections
+    unsigned char *base; // Start of the buffer the heap was initialised with
+    unsigned char *base_end; // End of the buffer the heap was initialised with
+    tiny_growth growth; // Obtains and releases additional memory chunks
+    bool growable; // Whether the heap may grow when exhausted
+    bool grown; // Whether the heap holds memory obtained by growing
+    tiny_grown_range grown_ranges[TINY_GROWN_RANGES]; // Memory obtained by growing
+    size_t grown_range_count; // How many entries `grown_ranges` holds
+    unsigned char *reserved; // Address space reserved for the heap, if any
+    size_t reserved_size; // Size of the reserved address space
+    unsigned char *committed; // End of the accessible start of the reservation
+    unsigned char *reserved_tail; // Accessible last page of the reservation
+    tiny_block *reserved_marker; // End marker of the reservation
+    size_t mmap_threshold; // Allocations this big get their own mapping, if not 0
+    uint32_t decay; // How long sections stay free before being purged, if not 0
+    unsigned char *mapping; // Memory the heap was mapped in, if any
+    size_t mapping_size; // Size of the mapping
+    size_t heap_page_size; // Size of the pages backing the mapping
+    bool locked; // Whether the mapping is locked in memory
+    uint32_t decay_clock; // Time of the last purge check, in milliseconds
+    size_t trim_threshold; // Free memory at the end that gets trimmed, if not 0
+    size_t trim_pad; // Bytes kept when trimming the end of the heap
+    unsigned char *trim_high; // End of the memory taken since the last trim
+    struct tiny_file_header *file; // Header of the file the heap is kept in, if any
+    uint64_t root; // Offset of the root object, unless the heap is kept in a file
+    struct tiny_shared_header *shared; // Header of the shared heap, if it is one
+    uint64_t generation; // Generation of the shared heap the counters match
+    bool last_zero; // Whether the last section taken was known to be zeroed
+};
+
+// Identifies heap files
+#define TINY_FILE_MAGIC "tinyheap"
+#define TINY_FILE_VERSION 1u
+
+// Starts a file a heap is kept in. The heap follows it, as laid out by
+// `tiny_init()`.
+typedef struct tiny_file_header {
+    char magic[8]; // TINY_FILE_MAGIC
+    uint32_t version; // TINY_FILE_VERSION
+    uint32_t alignment; // Block size the heap was laid out with
+    uint64_t size; // Length of the file, in bytes
+    uint64_t root; // Offset of the root object, 0 when there is none
+} tiny_file_header;
+
+// How many bytes of a heap file precede the heap
+enum { FILE_HEADER_SIZE = ALIGN_SIZE(sizeof(tiny_file_header)) };
+
+#ifdef TINY_SHARED
+// Starts a shared memory segment a heap is kept in, which several processes
+// may attach to. The heap follows it, as laid out by `tiny_init()`.
+typedef struct tiny_shared_header {
+    tiny_file_header file; // Describes the heap as a file header would
+    pthread_mutex_t lock; // Held by the process changing the heap
+    uint64_t generation; // Bumped by every change, so processes know to recount
+    bool broken; // Whether a process died leaving the heap unsound
+    atomic_uint ready; // Set by the creator once the heap is initialised
+} tiny_shared_header;
+
+// How many bytes of a shared memory segment precede the heap
+enum { SHARED_HEADER_SIZE = ALIGN_SIZE(sizeof(tiny_shared_header)) };
+
+// How long, in milliseconds, processes attaching to a shared heap wait for its
+// creator to initialise it
+enum { SHARED_WAIT = 1000 };
+#endif
+
+// The main library context
+static struct tiny_context tiny_main = TINY_INITIAL;
+
+// The context operated on by the calling thread. It is the main context unless
+// allocations are routed to per-node heaps.
+static THREAD_LOCAL struct tiny_context *tiny_heap = &tiny_main;
+#define tiny (*tiny_heap)
+
+#ifndef TINY_NUMA_NODES
+#define TINY_NUMA_NODES 8
+#endif
+
+// Heaps of each NUMA node, by node. The first node with memory uses the main
+// context.
+static struct tiny_context tiny_node_contexts[TINY_NUMA_NODES];
+static struct tiny_context *tiny_nodes[TINY_NUMA_NODES];
+static unsigned tiny_node_count; // How many nodes have heaps
+static bool tiny_numa_routing; // Whether allocations go to the heap of their node
+
+// How many allocations a thread makes before checking again which node it
+// runs on
+enum { NUMA_RECHECK = 64 };
+static THREAD_LOCAL unsigned numa_countdown;
+
+// Default size of the chunks the heap grows by
+enum { GROWTH_INCREMENT = 1 << 20 };
 
-// Writes a header size and availability
-static void write_header(tiny_block *header, size_t size, bool taken) {
-    *(size_t *)header = taken ? TAKEN_BIT | size : size;
+// Free sections are stamped, in their first block, with the time they were
+// freed, in milliseconds. The upper bit marks sections whose pages were purged.
+#define PURGED_BIT ((uint32_t)1 << 31)
+#define STAMP_MASK (PURGED_BIT - 1)
+
+// Size mapped heaps are aligned to, that of the transparent huge pages that
+// may back them
+enum { HUGE_PAGE_SIZE = 1 << 21 };
+
+// Reserved address space is committed in steps of this size, and decommitted
+// only when more than this is free at the end of the committed area
+enum { COMMIT_INCREMENT = 1 << 16 };
+
+// Whether the calling thread holds the lock of the shared heap it operates on
+static THREAD_LOCAL bool shared_held;
+
+// The tag given to allocations that are not explicitly tagged
+static THREAD_LOCAL unsigned current_tag;
+
+// Marks a stamp of a section that was not allocated while profiling
+#define UNSTAMPED UINT64_MAX
+
+// Fires an event hook, if installed. When no hooks are set, this costs a
+// single branch that is predicted not taken.
+#define FIRE_HOOK(event, ...) do {                                      \
+    if(UNLIKELY(tiny.hooks != NULL) && tiny.hooks->event != NULL) {     \
+        tiny.hooks->event(tiny.hooks->context, __VA_ARGS__);            \
+    }                                                                   \
+} while(0)
+
+// Writes a header size, availability and tag
+static void write_header(tiny_block *header, size_t size, bool taken, unsigned tag) {
+    *(size_t *)header = taken ? 
+        TAKEN_BIT | (size_t)tag << TAG_SHIFT | size : 
+        size;
 }
 
 // Parses a header and returns the parsed information
 static tiny_block_section read_header(tiny_block *header) {
     size_t header_value = *(size_t *)header;
+    size_t flags = header_value & (TAKEN_BIT | TAG_MASK);
+    bool bridge = flags == BRIDGE_BITS;
+    bool zero = flags == ZERO_BITS;
     tiny_block_section section = { 
-        header_value & TAKEN_BIT,
-        header_value & ~TAKEN_BIT,
+        flags != 0 && !zero,
+        header_value & SIZE_MASK,
         header,
-        (void *)(header + HEADER_BLOCKS) 
+        (void *)(header + HEADER_BLOCKS),
+        bridge || zero ? 0 : (header_value & TAG_MASK) >> TAG_SHIFT,
+        bridge,
+        zero
     };
     return section;
 }
 
+// Writes a bridge that links a header to the start of the next region
+static void write_bridge(tiny_block *header, tiny_block *target) {
+    *(size_t *)header = BRIDGE_BITS | (size_t)(target - header - HEADER_BLOCKS);
+}
+
+// Marks a free section as zeroed past its first block
+static void mark_zero(tiny_block *header) {
+    *(size_t *)header |= ZERO_BITS;
+}
+
+// Reads and writes the time a free section was freed at, kept in its first
+// block
+static uint32_t read_stamp(tiny_block *header) {
+    return *(uint32_t *)(header + HEADER_BLOCKS);
+}
+
+static void write_stamp(tiny_block *header, uint32_t stamp) {
+    *(uint32_t *)(header + HEADER_BLOCKS) = stamp;
+}
+
+// Returns a coarse monotonic time, in milliseconds, for decay stamps
+static uint32_t clock_ms(void) {
+    #ifdef TINY_POSIX
+    struct timespec now;
+    #ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    #else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    #endif
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000) & STAMP_MASK;
+    #else
+    return 0;
+    #endif
+}
+
+// Blocks copied or cleared at once from this size on bypass the caches, as
+// they would only evict what is about to be used. It depends on the caches of
+// the machine, so it is shared by every heap.
+static size_t stream_threshold = TINY_STREAM_THRESHOLD;
+
+#ifdef TINY_STREAM_X86
+enum { SIMD_NONE, SIMD_SSE2, SIMD_AVX2 };
+
+// Returns the widest vector instructions the processor supports, asking it
+// once
+static int simd_level(void) {
+    static atomic_int level = -1;
+    int current = atomic_load_explicit(&level, memory_order_relaxed);
+    if(UNLIKELY(current < 0)) {
+        __builtin_cpu_init();
+        current = __builtin_cpu_supports("avx2") ? SIMD_AVX2 : 
+            __builtin_cpu_supports("sse2") ? SIMD_SSE2 : SIMD_NONE;
+        atomic_store_explicit(&level, current, memory_order_relaxed);
+    }
+    return current;
+}
+
+// Streams 16 byte vectors, 64 bytes at a time, and stores what is left
+__attribute__((target("sse2")))
+static void stream_copy_sse2(unsigned char *dst, const unsigned char *src, size_t size) {
+    size_t i = 0, end = size / 64 * 64;
+    for(; i < end; i += 64) {
+        __m128i a = _mm_load_si128((const __m128i *)(src + i));
+        __m128i b = _mm_load_si128((const __m128i *)(src + i + 16));
+        __m128i c = _mm_load_si128((const __m128i *)(src + i + 32));
+        __m128i d = _mm_load_si128((const __m128i *)(src + i + 48));
+        _mm_stream_si128((__m128i *)(dst + i), a);
+        _mm_stream_si128((__m128i *)(dst + i + 16), b);
+        _mm_stream_si128((__m128i *)(dst + i + 32), c);
+        _mm_stream_si128((__m128i *)(dst + i + 48), d);
+    }
+    for(; i < size; i += 16) {
+        _mm_store_si128((__m128i *)(dst + i), _mm_load_si128((const __m128i *)(src + i)));
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("sse2")))
+static void stream_zero_sse2(unsigned char *dst, size_t size) {
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0, end = size / 64 * 64;
+    for(; i < end; i += 64) {
+        _mm_stream_si128((__m128i *)(dst + i), zero);
+        _mm_stream_si128((__m128i *)(dst + i + 16), zero);
+        _mm_stream_si128((__m128i *)(dst + i + 32), zero);
+        _mm_stream_si128((__m128i *)(dst + i + 48), zero);
+    }
+    for(; i < size; i += 16) {
+        _mm_store_si128((__m128i *)(dst + i), zero);
+    }
+    _mm_sfence();
+}
+
+// Streams 32 byte vectors, 128 bytes at a time. A leading 16 byte vector
+// aligns them, and what is left is stored.
+__attribute__((target("avx2")))
+static void stream_copy_avx2(unsigned char *dst, const unsigned char *src, size_t size) {
+    size_t i = 0;
+    if((uintptr_t)dst % 32 != 0) {
+        _mm_store_si128((__m128i *)dst, _mm_load_si128((const __m128i *)src));
+        i = 16;
+    }
+    size_t end = i + (size - i) / 128 * 128;
+    for(; i < end; i += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+        _mm256_stream_si256((__m256i *)(dst + i), a);
+        _mm256_stream_si256((__m256i *)(dst + i + 32), b);
+        _mm256_stream_si256((__m256i *)(dst + i + 64), c);
+        _mm256_stream_si256((__m256i *)(dst + i + 96), d);
+    }
+    for(; i < size; i += 16) {
+        _mm_store_si128((__m128i *)(dst + i), _mm_load_si128((const __m128i *)(src + i)));
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void stream_zero_avx2(unsigned char *dst, size_t size) {
+    size_t i = 0;
+    if((uintptr_t)dst % 32 != 0) {
+        _mm_store_si128((__m128i *)dst, _mm_setzero_si128());
+        i = 16;
+    }
+    __m256i zero = _mm256_setzero_si256();
+    size_t end = i + (size - i) / 128 * 128;
+    for(; i < end; i += 128) {
+        _mm256_stream_si256((__m256i *)(dst + i), zero);
+        _mm256_stream_si256((__m256i *)(dst + i + 32), zero);
+        _mm256_stream_si256((__m256i *)(dst + i + 64), zero);
+        _mm256_stream_si256((__m256i *)(dst + i + 96), zero);
+    }
+    for(; i < size; i += 16) {
+        _mm_store_si128((__m128i *)(dst + i), _mm_setzero_si128());
+    }
+    _mm_sfence();
+}
+#endif
+
+#ifdef TINY_STREAM_NEON
+// Streams pairs of 16 byte vectors, and stores what is left
+static void stream_copy_neon(unsigned char *dst, const unsigned char *src, size_t size) {
+    size_t i = 0, end = size / 32 * 32;
+    for(; i < end; i += 32) {
+        uint8x16_t a = vld1q_u8(src + i), b = vld1q_u8(src + i + 16);
+        __asm__ volatile("stnp %q0, %q1, [%2]" : : "w"(a), "w"(b), "r"(dst + i) : "memory");
+    }
+    if(i < size) {
+        vst1q_u8(dst + i, vld1q_u8(src + i));
+    }
+}
+
+static void stream_zero_neon(unsigned char *dst, size_t size) {
+    uint8x16_t zero = vdupq_n_u8(0);
+    size_t i = 0, end = size / 32 * 32;
+    for(; i < end; i += 32) {
+        __asm__ volatile("stnp %q0, %q0, [%1]" : : "w"(zero), "r"(dst + i) : "memory");
+    }
+    if(i < size) {
+        vst1q_u8(dst + i, zero);
+    }
+}
+#endif
+
+// Copies `size` bytes of whole blocks between sections that do not overlap.
+// Since both start on block boundaries and span whole blocks, the kernels that
+// stream large copies need neither alignment checks nor byte tails. Smaller
+// copies are left to `memcpy()`, which is as fast when they stay cached.
+static void copy_blocks(void *dst, const void *src, size_t size) {
+    if(ALIGNMENT % 16 == 0 && stream_threshold != 0 && size >= stream_threshold && size >= 64) {
+        #if defined(TINY_STREAM_X86)
+        int level = simd_level();
+        if(level == SIMD_AVX2) {
+            stream_copy_avx2(dst, src, size);
+            return;
+        } else if(level == SIMD_SSE2) {
+            stream_copy_sse2(dst, src, size);
+            return;
+        }
+        #elif defined(TINY_STREAM_NEON)
+        stream_copy_neon(dst, src, size);
+        return;
+        #endif
+    }
+    memcpy(dst, src, size);
+}
+
+// Clears `size` bytes of whole blocks, bypassing the caches if `stream` is set
+// or they are too many
+static void zero_blocks(void *dst, size_t size, bool stream) {
+    stream = stream || (stream_threshold != 0 && size >= stream_threshold);
+    if(ALIGNMENT % 16 == 0 && stream && size >= 64) {
+        #if defined(TINY_STREAM_X86)
+        int level = simd_level();
+        if(level == SIMD_AVX2) {
+            stream_zero_avx2(dst, size);
+            return;
+        } else if(level == SIMD_SSE2) {
+            stream_zero_sse2(dst, size);
+            return;
+        }
+        #elif defined(TINY_STREAM_NEON)
+        stream_zero_neon(dst, size);
+        return;
+        #endif
+    }
+    memset(dst, 0, size);
+}
+
+// Accounts for a section entering the heap
+static void count_section(size_t blocks, bool taken, unsigned tag) {
+    tiny_counters *counters = &tiny.counters;
+    counters->sections.total++;
+    if(taken) {
+        counters->sections.taken++;
+        counters->taken_blocks += blocks;
+        if(counters->taken_blocks > counters->peak_blocks) {
+            counters->peak_blocks = counters->taken_blocks;
+        }
+        tiny_tag_counters *tag_counters = &counters->tags[tag];
+        tag_counters->live_blocks += blocks;
+        if(tag_counters->live_blocks > tag_counters->peak_blocks) {
+            tag_counters->peak_blocks = tag_counters->live_blocks;
+        }
+    } else {
+        counters->sections.free++;
+        counters->free_blocks += blocks;
+        if(blocks > counters->largest_free) {
+            counters->largest_free = blocks;
+        }
+    }
+}
+
+// Accounts for a section leaving the heap
+static void uncount_section(size_t blocks, bool taken, unsigned tag) {
+    tiny_counters *counters = &tiny.counters;
+    counters->sections.total--;
+    if(taken) {
+        counters->sections.taken--;
+        counters->taken_blocks -= blocks;
+        counters->tags[tag].live_blocks -= blocks;
+    } else {
+        counters->sections.free--;
+        counters->free_blocks -= blocks;
+        if(blocks == counters->largest_free) {
+            counters->largest_stale = true;
+        }
+    }
+}
+
+// Returns the granularity memory is obtained from and released to the system
+static size_t page_size(void) {
+    #ifdef TINY_POSIX
+    static size_t size = 0;
+    if(size == 0) {
+        size = (size_t)sysconf(_SC_PAGESIZE);
+    }
+    return size;
+    #else
+    return 4096;
+    #endif
+}
+
+// Returns the size of the huge pages `MAP_HUGETLB` maps by default, as the
+// system reports it in `/proc/meminfo`, or 0 if it does not. The file is read
+// into the stack, since this may run before anything can be allocated.
+static size_t hugetlb_page_size(void) {
+    #ifdef __linux__
+    static size_t size = 0;
+    if(size != 0) {
+        return size;
+    }
+    char text[4096];
+    size_t length = 0;
+    int fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return 0;
+    }
+    for(;;) {
+        ssize_t count = read(fd, text + length, sizeof(text) - 1 - length);
+        if(count <= 0) {
+            break;
+        }
+        length += (size_t)count;
+    }
+    close(fd);
+    text[length] = '\0';
+    const char *field = strstr(text, "Hugepagesize:");
+    if(field == NULL) {
+        return 0;
+    }
+    size_t kib = 0;
+    for(field += strlen("Hugepagesize:"); *field == ' '; field++);
+    for(; *field >= '0' && *field <= '9'; field++) {
+        kib = kib * 10 + (size_t)(*field - '0');
+    }
+    size = kib << 10;
+    return size;
+    #else
+    return 0;
+    #endif
+}
+
+// Returns the size of the pages backing the heap, the unit memory is returned
+// to the system in
+static size_t heap_page(void) {
+    return tiny.heap_page_size != 0 ? tiny.heap_page_size : page_size();
+}
+
+// Rounds a pointer up or down to a boundary of the pages backing the heap
+static unsigned char *page_up(void *ptr) {
+    return (unsigned char *)(((uintptr_t)ptr + heap_page() - 1) & ~(heap_page() - 1));
+}
+
+static unsigned char *page_down(void *ptr) {
+    return (unsigned char *)((uintptr_t)ptr & ~(heap_page() - 1));
+}
+
+// Makes reserved address space accessible up to an address, committing it in
+// steps so that growing the heap a little at a time seldom needs a syscall
+static bool commit_until(unsigned char *end) {
+    #ifdef TINY_POSIX
+    if(end <= tiny.committed || tiny.committed >= tiny.reserved_tail) {
+        return true;
+    }
+    unsigned char *committed = tiny.committed + COMMIT_INCREMENT;
+    if(committed < end) {
+        committed = end;
+    }
+    committed = page_up(committed);
+    if(committed > tiny.reserved_tail) {
+        committed = tiny.reserved_tail;
+    }
+    if(mprotect(tiny.committed, committed - tiny.committed, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    tiny.committed = committed;
+    return true;
+    #else
+    (void)end;
+    return false;
+    #endif
+}
+
+// Commits what taking some blocks of a section writes to: the blocks taken
+// and, when the section is split, the header and the first block of the
+// remainder, where its decay stamp is kept
+static bool commit_section(tiny_block *header, size_t size, size_t block_count) {
+    unsigned char *start = (unsigned char *)header;
+    if(start < tiny.reserved || start >= tiny.reserved + tiny.reserved_size) {
+        return true;
+    }
+    tiny_block *end = size - block_count <= HEADER_BLOCKS ?
+        header + HEADER_BLOCKS + size :
+        header + 2 * HEADER_BLOCKS + block_count + 1;
+    return commit_until((unsigned char *)end);
+}
+
+// Decommits the free end of the committed area, past the header and the first
+// block of the free section it starts in
+static void decommit_from(tiny_block *header) {
+    #ifdef TINY_POSIX
+    unsigned char *keep = page_up(header + HEADER_BLOCKS + 1);
+    if(keep + COMMIT_INCREMENT >= tiny.committed) {
+        return;
+    }
+    madvise(keep, tiny.committed - keep, MADV_DONTNEED);
+    mprotect(keep, tiny.committed - keep, PROT_NONE);
+    tiny.committed = keep;
+    #else
+    (void)header;
+    #endif
+}
+
 // Allocates some blocks of memory in the provided section.
 // If the section is bigger than necessary, it may be split and a new section
 // with the remaining space may be created.
-static void allocate_at(tiny_block_section section, size_t block_count) {
+// Returns false, leaving the section untouched, if it lies in reserved address
+// space that could not be committed.
+static bool allocate_at(tiny_block_section section, size_t block_count, unsigned tag) {
+    if(UNLIKELY(tiny.reserved != NULL) && !commit_section(section.header, section.size, block_count)) {
+        return false;
+    }
     size_t remaining_space = 
         section.size - block_count;
+    // The remainder of a free section keeps the time the section was freed,
+    // and that of a taken one, which is being shrunk, is freed now
+    uint32_t stamp = 0;
+    if(UNLIKELY(tiny.decay != 0)) {
+        stamp = section.taken ? tiny.decay_clock : read_stamp(section.header) & STAMP_MASK;
+    }
 
+    if(UNLIKELY(tiny.trim_threshold != 0)) {
+        unsigned char *end = (unsigned char *)(section.header + HEADER_BLOCKS + block_count);
+        if(end > tiny.trim_high) {
+            tiny.trim_high = end;
+        }
+    }
+
+    // What remains of a zeroed section is still zeroed
+    tiny.last_zero = !section.taken && section.zero;
+    uncount_section(section.size, section.taken, section.tag);
     if(remaining_space <= HEADER_BLOCKS) {
-        write_header(section.header, section.size, true);
+        write_header(section.header, section.size, true, tag);
+        count_section(section.size, true, tag);
     } else {
-        write_header(section.header, block_count, true);
+        write_header(section.header, block_count, true, tag);
+        count_section(block_count, true, tag);
+        count_section(remaining_space - HEADER_BLOCKS, false, 0);
         write_header(
             section.header + block_count + HEADER_BLOCKS, 
             remaining_space - HEADER_BLOCKS, 
-            false
+            false,
+            0
+        );
+        if(tiny.last_zero) {
+            mark_zero(section.header + block_count + HEADER_BLOCKS);
+        }
+        if(UNLIKELY(tiny.decay != 0)) {
+            write_stamp(section.header + block_count + HEADER_BLOCKS, stamp);
+        }
+        FIRE_HOOK(
+            split,
+            section.header, block_count,
+            section.header + block_count + HEADER_BLOCKS,
+            remaining_space - HEADER_BLOCKS
         );
     }
+    return true;
 }
 
 // Returns the address of the next section
@@ -145,139 +819,2395 @@ static tiny_block *next_section(tiny_block *header) {
     return header + info.size + HEADER_BLOCKS;
 }
 
+// Returns the size of the largest free section at or after a header
+static size_t largest_free_from(tiny_block *header) {
+    size_t largest = 0;
+    tiny_block_section section = read_header(header);
+    while(section.size > 0) {
+        if(!section.taken && section.size > largest) {
+            largest = section.size;
+        }
+        header = next_section(header);
+        section = read_header(header);
+    }
+    return largest;
+}
+
+// Stamps every free section as freed at some time, in milliseconds
+static void stamp_free_sections(uint32_t stamp) {
+    if(tiny.buffer == NULL) {
+        return;
+    }
+    tiny_block *header = &tiny.buffer[0];
+    tiny_block_section section = read_header(header);
+    while(section.size > 0) {
+        if(!section.taken) {
+            write_stamp(header, stamp);
+        }
+        header = next_section(header);
+        section = read_header(header);
+    }
+}
+
+// Rebuilds the running statistics and the heap size by walking the whole
+// heap. Operation counts are kept, and so are peaks unless asked otherwise.
+static void recount(bool reset_peaks) {
+    tiny_counters *counters = &tiny.counters;
+    tiny_sections empty = { 0, 0, 0 };
+    counters->free_blocks = 0;
+    counters->taken_blocks = 0;
+    counters->largest_free = 0;
+    counters->largest_stale = false;
+    counters->sections = empty;
+    for(size_t i = 0; i < TINY_TAGS; i++) {
+        counters->tags[i].live_blocks = 0;
+    }
+    tiny.size = 0;
+    if(tiny.buffer != NULL) {
+        tiny_block *header = &tiny.buffer[0];
+        tiny_block_section section = read_header(header);
+        while(section.size > 0) {
+            if(!section.bridge) {
+                count_section(section.size, section.taken, section.tag);
+                tiny.size += section.size + HEADER_BLOCKS;
+            }
+            header = next_section(header);
+            section = read_header(header);
+        }
+        tiny.size -= HEADER_BLOCKS;
+    }
+    if(reset_peaks && tiny.decay != 0) {
+        stamp_free_sections(tiny.decay_clock);
+    }
+    if(reset_peaks) {
+        counters->peak_blocks = counters->taken_blocks;
+        for(size_t i = 0; i < TINY_TAGS; i++) {
+            counters->tags[i].peak_blocks = counters->tags[i].live_blocks;
+        }
+    }
+}
+
+// Converts the running statistics of a tag into their public form
+static tiny_tag_stats make_tag_stats(unsigned tag) {
+    const tiny_tag_counters *counters = &tiny.counters.tags[tag];
+    tiny_tag_stats stats = {
+        { counters->live_blocks, counters->live_blocks * ALIGNMENT },
+        { counters->peak_blocks, counters->peak_blocks * ALIGNMENT },
+        counters->allocations
+    };
+    return stats;
+}
+
+// Converts the running statistics into their public form
+static tiny_stats make_stats(void) {
+    const tiny_counters *counters = &tiny.counters;
+    tiny_stats stats = {
+        { counters->free_blocks, counters->free_blocks * ALIGNMENT },
+        { counters->taken_blocks, counters->taken_blocks * ALIGNMENT },
+        { counters->peak_blocks, counters->peak_blocks * ALIGNMENT },
+        { counters->largest_free, counters->largest_free * ALIGNMENT },
+        counters->sections,
+        { 0 },
+        counters->failures,
+        { counters->mapped_blocks, counters->mapped_blocks * ALIGNMENT },
+        counters->mappings
+    };
+    memcpy(stats.operations, counters->operations, sizeof(stats.operations));
+    return stats;
+}
+
+// How many operations go by between two publications of all statistics
+enum { STATS_INTERVAL = 64 };
+
+// Publishes the running statistics to the shared page under a seqlock.
+// Readers retry while the sequence is odd or has changed during their read.
+// Each operation publishes its own count, its failure and free and taken
+// memory, and all statistics are published every `STATS_INTERVAL` operations.
+static void publish_stats(enum tiny_function function, bool success) {
+    tiny_stats_page *page = tiny.stats_page;
+    const tiny_counters *counters = &tiny.counters;
+    size_t sequence = page->sequence;
+    page->sequence = sequence + 1;
+    atomic_thread_fence(memory_order_release);
+    if(tiny.stats_countdown == 0) {
+        page->stats = make_stats();
+        tiny.stats_countdown = STATS_INTERVAL;
+    } else {
+        page->stats.operations[function] = counters->operations[function];
+        if(!success) {
+            page->stats.failures = counters->failures;
+        }
+        page->stats.free.blocks = counters->free_blocks;
+        page->stats.free.bytes = counters->free_blocks * ALIGNMENT;
+        page->stats.taken.blocks = counters->taken_blocks;
+        page->stats.taken.bytes = counters->taken_blocks * ALIGNMENT;
+    }
+    tiny.stats_countdown--;
+    atomic_thread_fence(memory_order_release);
+    page->sequence = sequence + 2;
+}
+
+// Returns the power-of-two bucket of a value, clamped to the bucket count
+static size_t log2_bucket(uint64_t value, size_t buckets) {
+    size_t bucket = 0;
+    while(value > 1 && bucket < buckets - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Stamps a newly taken section with the current allocation epoch
+static void stamp_section(tiny_block *header) {
+    size_t index = header - tiny.buffer;
+    if(index < tiny.stamp_count) {
+        tiny.stamps[index] = tiny.lifetimes.epoch;
+    }
+    tiny.lifetimes.epoch++;
+}
+
+// Records the lifetime of a section that is being freed
+static void record_lifetime(tiny_block *header, size_t blocks) {
+    size_t index = header - tiny.buffer;
+    if(index >= tiny.stamp_count || tiny.stamps[index] == UNSTAMPED) {
+        return;
+    }
+    uint64_t lifetime = tiny.lifetimes.epoch - tiny.stamps[index];
+    tiny_lifetime_size *size = 
+        &tiny.lifetimes.sizes[log2_bucket(blocks, TINY_LIFETIME_SIZES)];
+    size->freed++;
+    size->total_lifetime += lifetime;
+    size->histogram[log2_bucket(lifetime, TINY_LIFETIME_BUCKETS)]++;
+    tiny.stamps[index] = UNSTAMPED;
+}
+
+// Merges every two consecutive free sections. This walks the whole heap, so
+// the largest free section is found on the way.
+// Returns the last section of the reserved address space if it is free.
+static tiny_block *merge_free_sections(void) {
+    size_t largest = 0;
+    tiny_block *reserved_tail = NULL;
+    tiny_block *header = &tiny.buffer[0];
+    tiny_block_section section = read_header(header);
+    while(section.size > 0) {
+        tiny_block *next = next_section(header);
+        if(!section.taken) {
+            tiny_block_section next_section = read_header(next);
+            if(!next_section.taken) {
+                if(UNLIKELY(tiny.decay != 0)) {
+                    // The merged section is as old as the youngest of both
+                    uint32_t stamp = read_stamp(header), next_stamp = read_stamp(next);
+                    uint32_t purged = stamp & next_stamp & PURGED_BIT;
+                    stamp &= STAMP_MASK;
+                    next_stamp &= STAMP_MASK;
+                    if(((next_stamp - stamp) & STAMP_MASK) < PURGED_BIT / 2) {
+                        stamp = next_stamp;
+                    }
+                    write_stamp(header, stamp | purged);
+                }
+                bool zero = section.zero && next_section.zero;
+                if(zero) {
+                    // Only the header and first block between them are not
+                    memset(next, 0, (HEADER_BLOCKS + 1) * ALIGNMENT);
+                }
+                write_header(header, section.size + next_section.size + HEADER_BLOCKS, false, 0);
+                if(zero) {
+                    mark_zero(header);
+                }
+                uncount_section(section.size, false, 0);
+                uncount_section(next_section.size, false, 0);
+                count_section(section.size + next_section.size + HEADER_BLOCKS, false, 0);
+                FIRE_HOOK(merge, header, next, section.size + next_section.size + HEADER_BLOCKS);
+                section = read_header(header);
+                continue;
+            }
+            if(section.size > largest) {
+                largest = section.size;
+            }
+            if(next == tiny.reserved_marker) {
+                reserved_tail = header;
+            }
+        }
+
+        header = next;
+        section = read_header(header);
+    } 
+    tiny.counters.largest_free = largest;
+    tiny.counters.largest_stale = false;
+    return reserved_tail;
+}
+
 // Stores the last operation performed by the library into the main context
 static void store_operation(enum tiny_function function, bool success, size_t size) {
     tiny_operation op = { function, success, size };
     tiny.last_operation = op;
+    tiny.counters.operations[function]++;
+    if(!success) {
+        tiny.counters.failures++;
+    }
+    if(UNLIKELY(tiny.stats_page != NULL)) {
+        publish_stats(function, success);
+    }
 }
 
-// Initialises the library with a buffer.
-// This will partition the buffer accordingly and allow allocating and
-// deallocating memory from it.
-void tiny_init(unsigned char *buffer, size_t size) {
-    unsigned char *aligned = ALIGN_PTR(buffer); 
-    size_t lost_alignment = aligned - buffer;
+static void *default_grow(void *context, void *hint, size_t size);
+
+// Returns whether purged pages of the heap read back as zeros, as pages of
+// private anonymous memory do. That is only known of heaps the library mapped
+// or reserved itself and grew, if at all, with `mmap()`, in regular pages that
+// are not locked, since locked pages cannot be purged and huge ones are purged
+// whole or not at all.
+static bool purge_zeroes(void) {
+    return (tiny.mapping != NULL || tiny.reserved != NULL) &&
+        tiny.file == NULL && tiny.shared == NULL && !tiny.locked &&
+        (tiny.heap_page_size == 0 || tiny.heap_page_size == page_size()) &&
+        (!tiny.grown || tiny.growth.grow == default_grow);
+}
+
+// Gives the pages of a range back to the system. Returns whether it did, which
+// it does not for locked memory, among others.
+static bool discard_pages(unsigned char *start, unsigned char *end) {
+    #ifdef TINY_POSIX
+    return madvise(start, end - start, MADV_DONTNEED) == 0;
+    #else
+    (void)start;
+    (void)end;
+    return false;
+    #endif
+}
+
+// Purges the pages of free sections, past their header and first block, so
+// that the system may reclaim them. With `decayed`, only sections that have
+// been free for the decay time are purged, once. The first `pad` bytes of the
+// section at the end of the heap are kept. Returns how many bytes were purged.
+static size_t purge_free_sections(bool decayed, uint32_t now, size_t pad) {
+    if(decayed) {
+        tiny.decay_clock = now;
+    }
+    if(tiny.buffer == NULL) {
+        return 0;
+    }
+
+    size_t purged = 0;
+    tiny_block *header = &tiny.buffer[0];
+    tiny_block_section section = read_header(header);
+    while(section.size > 0) {
+        tiny_block *next = next_section(header);
+        if(section.taken) {
+            header = next;
+            section = read_header(header);
+            continue;
+        }
+        uint32_t stamp = tiny.decay != 0 ? read_stamp(header) : 0;
+        if(decayed && ((stamp & PURGED_BIT) || ((now - stamp) & STAMP_MASK) < tiny.decay)) {
+            header = next;
+            section = read_header(header);
+            continue;
+        }
+
+        unsigned char *start = page_up(header + HEADER_BLOCKS + 1);
+        unsigned char *end = page_down(next);
+        tiny_block_section next_info = read_header(next);
+        unsigned char *padded = page_up((unsigned char *)section.data + pad);
+        if(next_info.size == 0 && padded > start) {
+            start = padded;
+        }
+        bool clipped = false;
+        if(
+            tiny.reserved != NULL && start >= tiny.reserved &&
+            start < tiny.reserved_tail && end > tiny.committed
+        ) {
+            // Decommitted memory holds no pages
+            end = tiny.committed;
+            clipped = true;
+        }
+        if(start < end && discard_pages(start, end)) {
+            purged += end - start;
+            unsigned char *first = (unsigned char *)(header + HEADER_BLOCKS + 1);
+            if(
+                !section.zero && !clipped && purge_zeroes() &&
+                (size_t)(start - first) + (size_t)((unsigned char *)next - end) <= 2 * page_size()
+            ) {
+                // Clearing what is left around the purged pages, at most two
+                // pages, leaves the section zeroed
+                memset(first, 0, start - first);
+                memset(end, 0, (unsigned char *)next - end);
+                mark_zero(header);
+            }
+        }
+        if(tiny.decay != 0) {
+            write_stamp(header, stamp | PURGED_BIT);
+        }
+        header = next;
+        section = read_header(header);
+    }
+    return purged;
+}
+
+// Faults in the pages of a range, so that they are not faulted in when used
+static void populate(unsigned char *start, unsigned char *end) {
+    start = page_down(start);
+    if(start >= end) {
+        return;
+    }
+    #if defined(TINY_POSIX) && defined(MADV_POPULATE_WRITE)
+    if(madvise(start, end - start, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+    #endif
+    // Writes every page back with its own contents
+    for(volatile unsigned char *page = start; page < end; page += page_size()) {
+        *page = *page;
+    }
+}
+
+// Obtains a chunk of memory from the system, near the hint if possible
+static void *default_grow(void *context, void *hint, size_t size) {
+    (void)context;
+    #ifdef TINY_POSIX
+    void *chunk = mmap(
+        hint, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    return chunk == MAP_FAILED ? NULL : chunk;
+    #else
+    (void)hint;
+    (void)size;
+    return NULL;
+    #endif
+}
+
+// Returns a chunk, or part of it, to the system
+static void default_release(void *context, void *chunk, size_t size) {
+    (void)context;
+    #ifdef TINY_POSIX
+    munmap(chunk, size);
+    #else
+    (void)chunk;
+    (void)size;
+    #endif
+}
+
+// Releases the part of a range that lies in whole pages
+static size_t release_range(unsigned char *start, unsigned char *end) {
+    start = page_up(start);
+    end = page_down(end);
+    if(start >= end) {
+        return 0;
+    }
+    tiny.growth.release(tiny.growth.context, start, end - start);
+    return end - start;
+}
+
+// Returns the end marker of the heap, where the last region ends
+static tiny_block *find_end_marker(void) {
+    tiny_block *header = &tiny.buffer[0];
+    tiny_block_section section = read_header(header);
+    while(section.size > 0) {
+        header = next_section(header);
+        section = read_header(header);
+    }
+    return header;
+}
+
+// Returns the range a chunk about to be linked is recorded in: one it extends,
+// or else a new one, which is left empty. Returns NULL if every range is
+// taken, as a heap grows by at most `TINY_GROWN_RANGES` separate ranges.
+static tiny_grown_range *grown_range_for(unsigned char *start, unsigned char *end) {
+    for(size_t i = 0; i < tiny.grown_range_count; i++) {
+        tiny_grown_range *range = &tiny.grown_ranges[i];
+        if(range->end == start || range->start == end) {
+            return range;
+        }
+    }
+    if(tiny.grown_range_count == TINY_GROWN_RANGES) {
+        return NULL;
+    }
+    tiny_grown_range empty = { NULL, NULL };
+    tiny.grown_ranges[tiny.grown_range_count] = empty;
+    return &tiny.grown_ranges[tiny.grown_range_count];
+}
+
+// Forgets the memory from an address to the end of the grown ranges it lies
+// in, as the heap shrinks
+static void forget_grown_from(unsigned char *start, unsigned char *end) {
+    size_t kept = 0;
+    for(size_t i = 0; i < tiny.grown_range_count; i++) {
+        tiny_grown_range range = tiny.grown_ranges[i];
+        if(range.start < end && range.end > start) {
+            if(range.start >= start) {
+                continue;
+            }
+            range.end = start;
+        }
+        tiny.grown_ranges[kept++] = range;
+    }
+    tiny.grown_range_count = kept;
+}
+
+// Links a chunk into the section chain, which is kept in address order.
+// The chunk is placed after the region that ends before it, whose end marker
+// or bridge is turned into a bridge to the chunk. If the chunk is adjacent to
+// either neighbouring region, they are joined into a contiguous region.
+static bool link_chunk(tiny_block *start, size_t blocks) {
+    tiny_block *end = start + blocks;
+    tiny_block *terminator = NULL; // Ends the region the chunk comes after
+    tiny_block *following = tiny.buffer; // Starts the region after the chunk
+
+    if(tiny.buffer != NULL && end > tiny.buffer) {
+        tiny_block *header = &tiny.buffer[0];
+        for(;;) {
+            tiny_block_section section = read_header(header);
+            if(section.bridge || section.size == 0) {
+                tiny_block *next = section.bridge ? next_section(header) : NULL;
+                if(start >= header + HEADER_BLOCKS && (next == NULL || end <= next)) {
+                    terminator = header;
+                    following = next;
+                    break;
+                }
+                if(next == NULL) {
+                    return false;
+                }
+            }
+            header = next_section(header);
+        }
+    }
+
+    // A region that ends right before the chunk absorbs it
+    tiny_block *first = start;
+    if(terminator != NULL && terminator + HEADER_BLOCKS == start) {
+        first = terminator;
+    } else if(terminator != NULL) {
+        write_bridge(terminator, start);
+    } else {
+        if(tiny.buffer != NULL) {
+            // Side table indices are relative to the start of the heap
+            tiny.stamps = NULL;
+        }
+        tiny.buffer = start;
+    }
+
+    // A region that starts right after the chunk is absorbed by it
+    if(following != NULL && end == following) {
+        write_header(first, end - first - HEADER_BLOCKS, false, 0);
+    } else {
+        tiny_block *last = end - HEADER_BLOCKS;
+        write_header(first, last - first - HEADER_BLOCKS, false, 0);
+        if(following != NULL) {
+            write_bridge(last, following);
+        } else {
+            write_header(last, 0, true, 0);
+        }
+    }
+    if(tiny.growth.grow == default_grow && !(following != NULL && end == following)) {
+        // The section holds nothing but the fresh chunk
+        mark_zero(first);
+    }
+    if(UNLIKELY(tiny.decay != 0)) {
+        write_stamp(first, tiny.decay_clock);
+    }
+
+    tiny.grown = true;
+    recount(false);
+    merge_free_sections();
+    return true;
+}
+
+// Grows the heap with a chunk that can hold at least some blocks
+static bool grow_heap(size_t blocks) {
+    // Room for the section, its header, an end marker and alignment slack
+    size_t overhead = 2 * HEADER_BLOCKS + 1;
+    if(!tiny.growable || blocks > SIZE_MASK - overhead) {
+        return false;
+    }
+    size_t increment = tiny.growth.increment ? tiny.growth.increment : GROWTH_INCREMENT;
+    size_t needed = (blocks + overhead) * ALIGNMENT;
+    size_t size = (needed + increment - 1) / increment * increment;
+    if(size < needed) {
+        return false;
+    }
+
+    void *hint = tiny.buffer ? find_end_marker() + HEADER_BLOCKS : NULL;
+    unsigned char *chunk = tiny.growth.grow(tiny.growth.context, hint, size);
+    if(chunk == NULL) {
+        return false;
+    }
+    tiny_block *start = (tiny_block *)ALIGN_PTR(chunk);
+    size_t chunk_blocks = (size - ((unsigned char *)start - chunk)) / ALIGNMENT;
+    tiny_grown_range *range = grown_range_for(
+        (unsigned char *)start, (unsigned char *)(start + chunk_blocks)
+    );
+    if(range == NULL || !link_chunk(start, chunk_blocks)) {
+        tiny.growth.release(tiny.growth.context, chunk, size);
+        return false;
+    }
+    if(range == &tiny.grown_ranges[tiny.grown_range_count]) {
+        tiny.grown_range_count++;
+    }
+    if(range->start == NULL || (unsigned char *)start < range->start) {
+        range->start = (unsigned char *)start;
+    }
+    if((unsigned char *)(start + chunk_blocks) > range->end) {
+        range->end = (unsigned char *)(start + chunk_blocks);
+    }
+    return true;
+}
+
+// Returns whether an allocation has its own mapping
+static bool is_mapped(void *ptr) {
+    size_t header = *(size_t *)((tiny_block *)ptr - HEADER_BLOCKS);
+    return (header & (TAKEN_BIT | TAG_MASK)) == MAPPED_BITS;
+}
+
+// Returns the length of the mapping of an allocation
+static size_t mapping_length(void *ptr) {
+    return *(size_t *)((tiny_block *)ptr - HEADER_BLOCKS) & SIZE_MASK;
+}
+
+// Returns the tag of an allocation with its own mapping
+static unsigned mapping_tag(void *ptr) {
+    return (unsigned)(*(size_t *)((tiny_block *)ptr - MAPPED_BLOCKS) & (TINY_TAGS - 1));
+}
+
+// Returns the bits kept along with the tag of a mapped allocation: its address,
+// scrambled with that of the library, so that foreign memory that happens to
+// look like a mapped header is not taken for one
+static size_t mapping_key(const unsigned char *mapping) {
+    uintptr_t scrambled = ((uintptr_t)mapping ^ (uintptr_t)&tiny_main) * (uintptr_t)0x9e3779b97f4a7c15ull;
+    return (size_t)scrambled & ~(size_t)(TINY_TAGS - 1);
+}
+
+// Returns whether a pointer that may not come from tiny is the data of an
+// allocation with its own mapping. Headers are only read when the mapping
+// would start on the page of the pointer, so foreign memory around it is
+// never touched.
+static bool owns_mapping(const void *ptr) {
+    uintptr_t mapping = (uintptr_t)ptr - MAPPED_BLOCKS * ALIGNMENT;
+    if(ptr == NULL || mapping % page_size() != 0) {
+        return false;
+    }
+    const size_t *words = (const size_t *)mapping;
+    return 
+        is_mapped((void *)ptr) && 
+        (words[0] & ~(size_t)(TINY_TAGS - 1)) == mapping_key((const unsigned char *)mapping);
+}
+
+// Returns how many bytes an allocation with its own mapping may use
+static size_t mapping_capacity(size_t length) {
+    return length - MAPPED_BLOCKS * ALIGNMENT;
+}
+
+// Returns the length of the mapping that holds some bytes, or 0 on overflow
+static size_t mapping_length_for(size_t size) {
+    size_t length = size + MAPPED_BLOCKS * ALIGNMENT + page_size() - 1;
+    if(length < size || length > SIZE_MASK) {
+        return 0;
+    }
+    return length & ~(page_size() - 1);
+}
+
+// Writes the headers of a mapping and accounts for it
+static void *track_mapping(unsigned char *mapping, size_t length, unsigned tag) {
+    tiny_block *data = (tiny_block *)mapping + MAPPED_BLOCKS;
+    *(size_t *)(data - MAPPED_BLOCKS) = mapping_key(mapping) | tag;
+    *(size_t *)(data - HEADER_BLOCKS) = MAPPED_BITS | length;
+
+    size_t blocks = mapping_capacity(length) / ALIGNMENT;
+    tiny_tag_counters *tag_counters = &tiny.counters.tags[tag];
+    tag_counters->live_blocks += blocks;
+    if(tag_counters->live_blocks > tag_counters->peak_blocks) {
+        tag_counters->peak_blocks = tag_counters->live_blocks;
+    }
+    tiny.counters.mapped_blocks += blocks;
+    tiny.counters.mappings++;
+    return data;
+}
+
+// Stops accounting for a mapping
+static void untrack_mapping(void *ptr) {
+    size_t blocks = mapping_capacity(mapping_length(ptr)) / ALIGNMENT;
+    tiny.counters.tags[mapping_tag(ptr)].live_blocks -= blocks;
+    tiny.counters.mapped_blocks -= blocks;
+    tiny.counters.mappings--;
+}
+
+// Serves an allocation with its own mapping, outside the heap
+static void *map_allocation(size_t size, unsigned tag) {
+    #ifdef TINY_POSIX
+    size_t length = mapping_length_for(size);
+    if(length == 0) {
+        return NULL;
+    }
+    unsigned char *mapping = mmap(
+        NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if(mapping == MAP_FAILED) {
+        return NULL;
+    }
+    return track_mapping(mapping, length, tag);
+    #else
+    (void)size;
+    (void)tag;
+    return NULL;
+    #endif
+}
+
+// Resizes an allocation with its own mapping. Where supported, the mapping is
+// remapped, so its contents are never copied.
+static void *remap_allocation(void *ptr, size_t size) {
+    #ifdef TINY_POSIX
+    size_t old_length = mapping_length(ptr), length = mapping_length_for(size);
+    if(length == 0) {
+        return NULL;
+    }
+    if(length == old_length) {
+        return ptr;
+    }
+    unsigned char *old_mapping = (unsigned char *)((tiny_block *)ptr - MAPPED_BLOCKS);
+    unsigned tag = mapping_tag(ptr);
+    #ifdef MREMAP_MAYMOVE
+    unsigned char *mapping = mremap(old_mapping, old_length, length, MREMAP_MAYMOVE);
+    if(mapping == MAP_FAILED) {
+        return NULL;
+    }
+    untrack_mapping(mapping + MAPPED_BLOCKS * ALIGNMENT);
+    #else
+    unsigned char *mapping = mmap(
+        NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if(mapping == MAP_FAILED) {
+        return NULL;
+    }
+    copy_blocks(mapping, old_mapping, old_length < length ? old_length : length);
+    untrack_mapping(ptr);
+    munmap(old_mapping, old_length);
+    #endif
+    return track_mapping(mapping, length, tag);
+    #else
+    (void)ptr;
+    (void)size;
+    return NULL;
+    #endif
+}
+
+// Returns an allocation with its own mapping to the system
+static void unmap_allocation(void *ptr) {
+    size_t length = mapping_length(ptr);
+    untrack_mapping(ptr);
+    #ifdef TINY_POSIX
+    munmap((tiny_block *)ptr - MAPPED_BLOCKS, length);
+    #endif
+}
+
+// Returns all memory obtained by growing to the system
+static void release_grown(void) {
+    tiny.grown_range_count = 0;
+    if(!tiny.grown || tiny.buffer == NULL) {
+        tiny.grown = false;
+        return;
+    }
+    tiny_block *region = &tiny.buffer[0];
+    tiny_block *header = region;
+    for(;;) {
+        tiny_block_section section = read_header(header);
+        if(section.bridge || section.size == 0) {
+            // The next region must be found before this one is released
+            tiny_block *next = section.bridge ? next_section(header) : NULL;
+            unsigned char *start = (unsigned char *)region;
+            unsigned char *end = (unsigned char *)(header + HEADER_BLOCKS);
+            if(start < tiny.base_end && end > tiny.base) {
+                release_range(start, tiny.base);
+                release_range(tiny.base_end, end);
+            } else {
+                release_range(start, end);
+            }
+            if(next == NULL) {
+                break;
+            }
+            region = header = next;
+            continue;
+        }
+        header = next_section(header);
+    }
+    tiny.grown = false;
+}
+
+// Returns the memory the heap was mapped in, or reserved, to the system
+static void release_owned(void) {
+    #ifdef TINY_POSIX
+    if(tiny.reserved != NULL) {
+        munmap(tiny.reserved, tiny.reserved_size);
+    }
+    if(tiny.mapping != NULL) {
+        munmap(tiny.mapping, tiny.mapping_size);
+    }
+    #endif
+    tiny.reserved = tiny.committed = tiny.reserved_tail = NULL;
+    tiny.reserved_marker = NULL;
+    tiny.reserved_size = 0;
+    tiny.mapping = NULL;
+    tiny.mapping_size = 0;
+    tiny.heap_page_size = 0;
+    tiny.locked = false;
+    tiny.file = NULL;
+    tiny.root = 0;
+    tiny.shared = NULL;
+}
+
+// Initialises the library with a buffer.
+// This will partition the buffer accordingly and allow allocating and
+// deallocating memory from it.
+void tiny_init(unsigned char *buffer, size_t size) {
+    unsigned char *aligned = ALIGN_PTR(buffer); 
+    size_t lost_alignment = aligned - buffer;
+
+    if(
+        lost_alignment + (2 * HEADER_BLOCKS + 1) * ALIGNMENT >= size ||
+        (size - lost_alignment) / ALIGNMENT > SIZE_MASK
+    ) {
+        store_operation(TINY_INIT, false, size);
+        return;
+    } 
+
+    release_grown();
+    release_owned();
+    tiny.buffer = (tiny_block *)aligned;
+    tiny.size = (size - lost_alignment) / ALIGNMENT - 2 * HEADER_BLOCKS;
+    tiny.base = buffer;
+    tiny.base_end = buffer + size;
+
+    write_header(&tiny.buffer[0], tiny.size, false, 0);
+    write_header(&tiny.buffer[tiny.size + HEADER_BLOCKS], 0, true, 0);
+    tiny.stamps = NULL;
+    recount(true);
+    store_operation(TINY_INIT, true, size);
+}
+
+// Initialises the library with address space reserved for a heap of up to
+// `max_size` bytes. Memory is committed as the heap is used and decommitted
+// when its end goes free, so only what is in use counts towards the resident
+// size. Returns whether the space could be reserved.
+bool tiny_init_reserved(size_t max_size) {
+    #ifdef TINY_POSIX
+    size_t size = (max_size + page_size() - 1) & ~(page_size() - 1);
+    if(
+        size < max_size || size < 2 * page_size() || 
+        size / ALIGNMENT > SIZE_MASK
+    ) {
+        store_operation(TINY_INIT, false, max_size);
+        return false;
+    }
+    unsigned char *reserved = mmap(
+        NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0
+    );
+    if(reserved == MAP_FAILED) {
+        store_operation(TINY_INIT, false, max_size);
+        return false;
+    }
+    // Only the first page, with the first header, and the last one, with the
+    // end marker, are accessible up front
+    unsigned char *tail = reserved + size - page_size();
+    if(
+        mprotect(reserved, page_size(), PROT_READ | PROT_WRITE) != 0 ||
+        mprotect(tail, page_size(), PROT_READ | PROT_WRITE) != 0
+    ) {
+        munmap(reserved, size);
+        store_operation(TINY_INIT, false, max_size);
+        return false;
+    }
+
+    release_grown();
+    release_owned();
+    tiny.reserved = reserved;
+    tiny.reserved_size = size;
+    tiny.committed = reserved + page_size();
+    tiny.reserved_tail = tail;
+    tiny.buffer = (tiny_block *)reserved;
+    tiny.size = size / ALIGNMENT - 2 * HEADER_BLOCKS;
+    tiny.reserved_marker = &tiny.buffer[tiny.size + HEADER_BLOCKS];
+    tiny.base = reserved;
+    tiny.base_end = reserved + size;
+
+    write_header(&tiny.buffer[0], tiny.size, false, 0);
+    mark_zero(&tiny.buffer[0]);
+    write_header(tiny.reserved_marker, 0, true, 0);
+    tiny.stamps = NULL;
+    recount(true);
+    store_operation(TINY_INIT, true, max_size);
+    return true;
+    #else
+    store_operation(TINY_INIT, false, max_size);
+    return false;
+    #endif
+}
+
+// Memory policy modes and flags, as in <linux/mempolicy.h>
+enum { NUMA_MPOL_BIND = 2, NUMA_MPOL_F_MEMS_ALLOWED = 1 << 2 };
+
+// How many nodes the node masks passed to the system can hold
+enum { NUMA_MASK_NODES = 1024 };
+
+// Returns the mask of the NUMA nodes the process may allocate memory on
+static unsigned long allowed_nodes(void) {
+    #if defined(__linux__) && defined(SYS_get_mempolicy)
+    unsigned long mask[NUMA_MASK_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    if(syscall(
+        SYS_get_mempolicy, NULL, mask, (unsigned long)NUMA_MASK_NODES,
+        NULL, (unsigned long)NUMA_MPOL_F_MEMS_ALLOWED
+    ) == 0 && mask[0] != 0) {
+        return mask[0];
+    }
+    #endif
+    return 1;
+}
+
+// Binds memory to a NUMA node
+static bool bind_to_node(void *start, size_t size, unsigned node) {
+    #if defined(__linux__) && defined(SYS_mbind)
+    unsigned long mask[NUMA_MASK_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << node % (8 * sizeof(unsigned long));
+    return syscall(
+        SYS_mbind, start, size, (unsigned long)NUMA_MPOL_BIND,
+        mask, (unsigned long)NUMA_MASK_NODES, 0ul
+    ) == 0;
+    #else
+    (void)start;
+    (void)size;
+    (void)node;
+    return true;
+    #endif
+}
+
+// Returns the NUMA node the calling thread runs on
+static unsigned current_node(void) {
+    #if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu, node;
+    if(syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+        return node;
+    }
+    #endif
+    return 0;
+}
+
+// Points the calling thread to the heap of the node it runs on, or to the main
+// context if allocations are not routed. Threads that use a context of their
+// own keep it.
+static void route_thread(void) {
+    numa_countdown = NUMA_RECHECK;
+    bool routed = tiny_heap == &tiny_main;
+    for(unsigned node = 0; node < TINY_NUMA_NODES && !routed; node++) {
+        routed = tiny_heap == tiny_nodes[node];
+    }
+    if(!routed) {
+        return;
+    }
+    struct tiny_context *context = &tiny_main;
+    if(tiny_numa_routing) {
+        unsigned node = current_node();
+        if(node < TINY_NUMA_NODES && tiny_nodes[node] != NULL) {
+            context = tiny_nodes[node];
+        }
+    }
+    tiny_heap = context;
+}
+
+// Returns the heap of the node that holds some memory, or the context of the
+// calling thread if none does
+static struct tiny_context *owner_of(void *ptr) {
+    unsigned char *address = ptr;
+    for(unsigned node = 0; node < TINY_NUMA_NODES; node++) {
+        struct tiny_context *context = tiny_nodes[node];
+        if(
+            context != NULL && address >= context->mapping &&
+            address < context->mapping + context->mapping_size
+        ) {
+            return context;
+        }
+    }
+    return tiny_heap;
+}
+
+static bool map_heap(size_t size, unsigned flags, int node);
+
+// Maps a heap of some size on each NUMA node the process may allocate memory
+// on, bound to it. The first node uses the main context. Heaps on other nodes
+// share its mapping threshold, hooks and decay but, so that the memory they
+// hold can be told apart, none of them grows. On a single node, this is the
+// same as `tiny_init_mapped()`. Returns whether every heap could be mapped.
+bool tiny_init_numa(size_t size, unsigned flags) {
+    unsigned long mask = allowed_nodes();
+    if(TINY_NUMA_NODES < 8 * sizeof(mask)) {
+        mask &= (1ul << TINY_NUMA_NODES) - 1;
+    }
+    struct tiny_context *previous = tiny_heap;
+    tiny_heap = &tiny_main;
+    for(unsigned node = 0; node < TINY_NUMA_NODES; node++) {
+        tiny_nodes[node] = NULL;
+    }
+    tiny_node_count = 0;
+    if((mask & (mask - 1)) == 0) {
+        // There is a single node to place memory on
+        bool mapped = map_heap(size, flags, -1);
+        tiny_heap = previous;
+        return mapped;
+    }
+
+    bool mapped = true;
+    for(unsigned node = 0; node < TINY_NUMA_NODES; node++) {
+        if(!(mask & (1ul << node))) {
+            continue;
+        }
+        struct tiny_context *context = tiny_node_count == 0 ? 
+            &tiny_main : &tiny_node_contexts[node];
+        if(context != &tiny_main) {
+            context->last_operation = tiny_main.last_operation;
+            context->mmap_threshold = tiny_main.mmap_threshold;
+            context->hooks = tiny_main.hooks;
+            context->decay = tiny_main.decay;
+        }
+        context->growable = false;
+        tiny_heap = context;
+        if(map_heap(size, flags, (int)node)) {
+            tiny_nodes[node] = context;
+            tiny_node_count++;
+        } else {
+            mapped = false;
+        }
+    }
+    tiny_heap = previous;
+    return mapped;
+}
+
+// Routes the allocations of each thread to the heap of the NUMA node it runs
+// on. Threads check where they run every few allocations. Does nothing unless
+// heaps were mapped on several nodes.
+void tiny_set_numa_routing(bool enabled) {
+    tiny_numa_routing = enabled;
+    numa_countdown = 0;
+}
+
+// Returns on how many NUMA nodes heaps were mapped
+unsigned tiny_numa_nodes() {
+    return tiny_node_count > 1 ? tiny_node_count : 1;
+}
+
+// Maps a buffer of some size and initialises the library with it. With
+// `TINY_MAP_HUGETLB`, the buffer is backed by huge pages from the system pool
+// and, with `TINY_MAP_HUGEPAGE`, transparent huge pages are requested for it.
+// If huge pages are not available, regular pages are used. With
+// `TINY_MAP_POPULATE` every page is faulted in up front and, with
+// `TINY_MAP_LOCK`, also locked in memory. Returns whether the buffer could be
+// mapped and locked.
+bool tiny_init_mapped(size_t size, unsigned flags) {
+    return map_heap(size, flags, -1);
+}
+
+// Maps a heap, as `tiny_init_mapped()`, with its memory bound to a NUMA node,
+// unless the node is negative
+static bool map_heap(size_t size, unsigned flags, int node) {
+    #ifdef TINY_POSIX
+    size_t length = (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+    if(length < size || length == 0) {
+        store_operation(TINY_INIT, false, size);
+        return false;
+    }
+
+    unsigned char *mapping = MAP_FAILED;
+    size_t heap_page_size = page_size();
+    #ifdef MAP_HUGETLB
+    size_t huge_page = hugetlb_page_size();
+    if((flags & TINY_MAP_HUGETLB) && huge_page != 0) {
+        // The mapping must span whole huge pages of the size the system gives
+        size_t huge_length = (size + huge_page - 1) & ~(huge_page - 1);
+        if(huge_length >= size) {
+            mapping = mmap(
+                NULL, huge_length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+            );
+        }
+        if(mapping != MAP_FAILED) {
+            length = huge_length;
+            heap_page_size = huge_page;
+        }
+    }
+    #endif
+    if(mapping == MAP_FAILED) {
+        // Maps a huge page more than needed, so that the mapping can be
+        // trimmed down to huge page boundaries
+        unsigned char *unaligned = mmap(
+            NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+        );
+        if(unaligned == MAP_FAILED) {
+            store_operation(TINY_INIT, false, size);
+            return false;
+        }
+        mapping = (unsigned char *)(
+            ((uintptr_t)unaligned + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1)
+        );
+        if(mapping > unaligned) {
+            munmap(unaligned, mapping - unaligned);
+        }
+        munmap(mapping + length, unaligned + HUGE_PAGE_SIZE - mapping);
+        // Transparent huge pages may be split, or never used, so memory is
+        // still returned to the system in regular pages
+        #ifdef MADV_HUGEPAGE
+        if(flags & TINY_MAP_HUGEPAGE) {
+            madvise(mapping, length, MADV_HUGEPAGE);
+        }
+        #endif
+    }
+    // Pages are placed when first touched, so this must come before that
+    if(node >= 0 && !bind_to_node(mapping, length, (unsigned)node)) {
+        munmap(mapping, length);
+        store_operation(TINY_INIT, false, size);
+        return false;
+    }
+
+    if(flags & TINY_MAP_POPULATE) {
+        populate(mapping, mapping + length);
+    }
+    // Locking faults every page in as well
+    if((flags & TINY_MAP_LOCK) && mlock(mapping, length) != 0) {
+        munmap(mapping, length);
+        store_operation(TINY_INIT, false, size);
+        return false;
+    }
+    tiny_init(mapping, length);
+    if(!tiny.last_operation.success) {
+        munmap(mapping, length);
+        return false;
+    }
+    tiny.mapping = mapping;
+    tiny.mapping_size = length;
+    tiny.heap_page_size = heap_page_size;
+    tiny.locked = (flags & TINY_MAP_LOCK) != 0;
+    // Fresh anonymous memory reads as zeros
+    mark_zero(&tiny.buffer[0]);
+    return true;
+    #else
+    (void)flags;
+    (void)node;
+    store_operation(TINY_INIT, false, size);
+    return false;
+    #endif
+}
+
+// Returns whether a heap laid out by `tiny_init()` holds a chain of sections
+// that ends exactly at its end marker, without bridges nor mapped headers
+static bool check_chain(tiny_block *buffer, size_t size) {
+    tiny_block *header = buffer;
+    tiny_block *end = buffer + size + HEADER_BLOCKS;
+    while(header < end) {
+        size_t value = *(size_t *)header;
+        size_t blocks = value & SIZE_MASK;
+        if(
+            ((value & TAG_MASK) && !(value & TAKEN_BIT)) ||
+            blocks == 0 || blocks > (size_t)(end - header) - HEADER_BLOCKS
+        ) {
+            return false;
+        }
+        header += HEADER_BLOCKS + blocks;
+    }
+    return header == end && *(size_t *)end == TAKEN_BIT;
+}
+
+// Operates on a heap already laid out by `tiny_init()` in a buffer whose start
+// is aligned, as it was left. The counters must be brought up to date after.
+static void attach_heap(unsigned char *start, unsigned char *end) {
+    release_grown();
+    release_owned();
+    tiny.buffer = (tiny_block *)start;
+    tiny.size = (end - start) / ALIGNMENT - 2 * HEADER_BLOCKS;
+    tiny.base = start;
+    tiny.base_end = end;
+    tiny.stamps = NULL;
+}
+
+// Opens a heap kept in a file, mapped shared so that everything allocated is
+// written back to it. An empty or missing file is created with `size` bytes and
+// a new heap; otherwise, the heap already in the file is checked and reused as
+// it is, whatever `size` is. Returns whether the heap could be opened. A file
+// that does not hold a valid heap is left untouched.
+bool tiny_open_file(const char *path, size_t size) {
+    #ifdef TINY_POSIX
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        store_operation(TINY_INIT, false, size);
+        return false;
+    }
+    struct stat status;
+    tiny_file_header header;
+    bool known = fstat(fd, &status) == 0;
+    bool created = false;
+    size_t length = 0;
+    if(known && status.st_size == 0) {
+        if(size > FILE_HEADER_SIZE && ftruncate(fd, (off_t)size) == 0) {
+            length = size;
+            created = true;
+        }
+    } else if(
+        known &&
+        pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        memcmp(header.magic, TINY_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == TINY_FILE_VERSION &&
+        header.alignment == ALIGNMENT &&
+        header.size == (uint64_t)status.st_size
+    ) {
+        length = (size_t)header.size;
+    }
+    unsigned char *mapping = MAP_FAILED;
+    if(length > FILE_HEADER_SIZE) {
+        mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        store_operation(TINY_INIT, false, size);
+        return false;
+    }
+
+    tiny_file_header *file = (tiny_file_header *)mapping;
+    if(created) {
+        tiny_init(mapping + FILE_HEADER_SIZE, length - FILE_HEADER_SIZE);
+        if(!tiny.last_operation.success) {
+            munmap(mapping, length);
+            return false;
+        }
+        memcpy(file->magic, TINY_FILE_MAGIC, sizeof(file->magic));
+        file->version = TINY_FILE_VERSION;
+        file->alignment = ALIGNMENT;
+        file->size = length;
+        file->root = 0;
+    } else {
+        // Takes the heap over if the chain of sections it holds is sound
+        unsigned char *start = mapping + FILE_HEADER_SIZE;
+        size_t blocks = (length - FILE_HEADER_SIZE) / ALIGNMENT;
+        if(
+            blocks <= 2 * HEADER_BLOCKS || 
+            !check_chain((tiny_block *)start, blocks - 2 * HEADER_BLOCKS)
+        ) {
+            munmap(mapping, length);
+            store_operation(TINY_INIT, false, size);
+            return false;
+        }
+        attach_heap(start, mapping + length);
+        recount(true);
+        store_operation(TINY_INIT, true, length - FILE_HEADER_SIZE);
+    }
+    // Neither memory obtained by growing nor allocations with their own
+    // mapping would be kept in the file
+    tiny.growable = false;
+    tiny.mmap_threshold = 0;
+    tiny.mapping = mapping;
+    tiny.mapping_size = length;
+    tiny.heap_page_size = page_size();
+    tiny.file = file;
+    return true;
+    #else
+    (void)path;
+    store_operation(TINY_INIT, false, size);
+    return false;
+    #endif
+}
+
+#ifdef TINY_SHARED
+// Initialises a process-shared robust mutex
+static bool init_lock(pthread_mutex_t *lock) {
+    pthread_mutexattr_t attributes;
+    if(pthread_mutexattr_init(&attributes) != 0) {
+        return false;
+    }
+    bool initialised = 
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED) == 0 &&
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST) == 0 &&
+        pthread_mutex_init(lock, &attributes) == 0;
+    pthread_mutexattr_destroy(&attributes);
+    return initialised;
+}
+
+// Maps a shared memory segment created by another process once it is sized.
+// Returns MAP_FAILED if that does not happen in time.
+static unsigned char *map_created(int fd, size_t *length) {
+    struct timespec pause = { 0, 1000000 };
+    for(unsigned waited = 0; waited < SHARED_WAIT; waited++) {
+        struct stat status;
+        if(fstat(fd, &status) != 0) {
+            break;
+        }
+        if((size_t)status.st_size > SHARED_HEADER_SIZE) {
+            *length = (size_t)status.st_size;
+            return mmap(NULL, *length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        nanosleep(&pause, NULL);
+    }
+    return MAP_FAILED;
+}
+
+// Waits for the creator of a shared heap to initialise it. Returns whether it
+// did in time.
+static bool wait_ready(tiny_shared_header *shared) {
+    struct timespec pause = { 0, 1000000 };
+    for(unsigned waited = 0; waited < SHARED_WAIT; waited++) {
+        if(atomic_load_explicit(&shared->ready, memory_order_acquire)) {
+            return true;
+        }
+        nanosleep(&pause, NULL);
+    }
+    return false;
+}
+#endif
+
+// Takes the lock of the shared heap, bringing the counters of this process up
+// to date if another one changed the heap since. If the last holder died, the
+// heap is checked and, if it was left unsound, no process may use it anymore.
+// Returns whether the heap may be used.
+static bool lock_shared(void) {
+    #ifdef TINY_SHARED
+    tiny_shared_header *shared = tiny.shared;
+    int error = pthread_mutex_lock(&shared->lock);
+    if(error == EOWNERDEAD) {
+        shared->broken = shared->broken || !check_chain(tiny.buffer, tiny.size);
+        shared->generation++;
+        pthread_mutex_consistent(&shared->lock);
+    } else if(error != 0) {
+        return false;
+    }
+    if(shared->broken) {
+        pthread_mutex_unlock(&shared->lock);
+        return false;
+    }
+    if(shared->generation != tiny.generation) {
+        recount(false);
+    }
+    shared_held = true;
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+// Releases the lock of the shared heap, letting other processes know it changed
+static void unlock_shared(void) {
+    #ifdef TINY_SHARED
+    shared_held = false;
+    tiny.generation = ++tiny.shared->generation;
+    pthread_mutex_unlock(&tiny.shared->lock);
+    #endif
+}
+
+// Opens a heap in a POSIX shared memory segment that other processes may
+// attach to, each at its own address. The process that creates the segment
+// sizes it with `size` bytes and initialises the heap; the others attach to it
+// as it is. Allocating, reallocating and freeing take a process-shared robust
+// lock. Returns whether the heap could be opened.
+bool tiny_open_shared(const char *name, size_t size) {
+    #ifdef TINY_SHARED
+    bool created = true;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(name, O_RDWR, 0);
+    }
+    if(fd < 0) {
+        store_operation(TINY_INIT, false, size);
+        return false;
+    }
+    size_t length = size;
+    unsigned char *mapping = MAP_FAILED;
+    if(!created) {
+        mapping = map_created(fd, &length);
+    } else if(size > SHARED_HEADER_SIZE && ftruncate(fd, (off_t)size) == 0) {
+        mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        if(created) {
+            shm_unlink(name);
+        }
+        store_operation(TINY_INIT, false, size);
+        return false;
+    }
+
+    tiny_shared_header *shared = (tiny_shared_header *)mapping;
+    if(created) {
+        if(!init_lock(&shared->lock)) {
+            munmap(mapping, length);
+            shm_unlink(name);
+            store_operation(TINY_INIT, false, size);
+            return false;
+        }
+        tiny_init(mapping + SHARED_HEADER_SIZE, length - SHARED_HEADER_SIZE);
+        if(!tiny.last_operation.success) {
+            munmap(mapping, length);
+            shm_unlink(name);
+            return false;
+        }
+        memcpy(shared->file.magic, TINY_FILE_MAGIC, sizeof(shared->file.magic));
+        shared->file.version = TINY_FILE_VERSION;
+        shared->file.alignment = ALIGNMENT;
+        shared->file.size = length;
+        shared->file.root = 0;
+        shared->generation = 0;
+        shared->broken = false;
+        tiny.generation = 0;
+        atomic_store_explicit(&shared->ready, 1, memory_order_release);
+    } else {
+        if(
+            !wait_ready(shared) ||
+            memcmp(shared->file.magic, TINY_FILE_MAGIC, sizeof(shared->file.magic)) != 0 ||
+            shared->file.version != TINY_FILE_VERSION ||
+            shared->file.alignment != ALIGNMENT ||
+            shared->file.size != length
+        ) {
+            munmap(mapping, length);
+            store_operation(TINY_INIT, false, size);
+            return false;
+        }
+        attach_heap(mapping + SHARED_HEADER_SIZE, mapping + length);
+        tiny.shared = shared;
+        tiny.mapping = mapping;
+        tiny.mapping_size = length;
+        if(!lock_shared()) {
+            tiny_clear();
+            store_operation(TINY_INIT, false, size);
+            return false;
+        }
+        recount(true);
+        tiny.generation = shared->generation;
+        shared_held = false;
+        pthread_mutex_unlock(&shared->lock);
+        store_operation(TINY_INIT, true, length - SHARED_HEADER_SIZE);
+    }
+    // Neither memory obtained by growing nor allocations with their own
+    // mapping would be visible to other processes
+    tiny.growable = false;
+    tiny.mmap_threshold = 0;
+    tiny.mapping = mapping;
+    tiny.mapping_size = length;
+    tiny.heap_page_size = page_size();
+    tiny.file = &shared->file;
+    tiny.shared = shared;
+    return true;
+    #else
+    (void)name;
+    store_operation(TINY_INIT, false, size);
+    return false;
+    #endif
+}
+
+// Returns the offset of a pointer into the heap from its start, which stays the
+// same wherever the heap is mapped. NULL is offset 0.
+uint64_t tiny_ptr_to_off(const void *ptr) {
+    return ptr == NULL ? 0 : (uint64_t)((const unsigned char *)ptr - (unsigned char *)tiny.buffer);
+}
+
+// Returns the pointer at an offset from the start of the heap. Offset 0 is NULL.
+void *tiny_off_to_ptr(uint64_t offset) {
+    return offset == 0 ? NULL : (unsigned char *)tiny.buffer + offset;
+}
+
+// Sets the root object of the heap, from which everything else in it can be
+// found. In heaps kept in files, it is kept in the file as well.
+void tiny_set_root(void *ptr) {
+    uint64_t offset = tiny_ptr_to_off(ptr);
+    if(tiny.file != NULL) {
+        tiny.file->root = offset;
+    } else {
+        tiny.root = offset;
+    }
+}
+
+// Returns the root object of the heap, or NULL if none was set
+void *tiny_root() {
+    return tiny_off_to_ptr(tiny.file != NULL ? tiny.file->root : tiny.root);
+}
+
+// Places a new context at the start of a buffer and initialises its heap with
+// the rest. It starts with no hooks, growth nor decay, and is operated on once
+// a thread uses it. Returns NULL if the buffer cannot hold both.
+tiny_context *tiny_create(unsigned char *buffer, size_t size) {
+    static const struct tiny_context initial = TINY_EMPTY;
+    uintptr_t start = (
+        ((uintptr_t)buffer + _Alignof(struct tiny_context) - 1) & 
+        ~(uintptr_t)(_Alignof(struct tiny_context) - 1)
+    );
+    size_t offset = start - (uintptr_t)buffer + sizeof(struct tiny_context);
+    if(buffer == NULL || size < offset) {
+        return NULL;
+    }
+    struct tiny_context *context = (struct tiny_context *)start;
+    *context = initial;
+    struct tiny_context *previous = tiny_use(context);
+    tiny_init(buffer + offset, size - offset);
+    bool success = tiny.last_operation.success;
+    tiny_use(previous);
+    return success ? context : NULL;
+}
+
+// Makes the calling thread operate on a context, or on the main one if NULL.
+// Returns the context it operated on before.
+tiny_context *tiny_use(tiny_context *context) {
+    struct tiny_context *previous = tiny_heap;
+    tiny_heap = context != NULL ? context : &tiny_main;
+    return previous;
+}
+
+// Clears the library buffer
+void tiny_clear() {
+    release_grown();
+    release_owned();
+    tiny.buffer = NULL;
+    tiny.size = 0;
+    tiny.base = tiny.base_end = NULL;
+    tiny.stamps = NULL;
+    recount(true);
+    store_operation(TINY_CLEAR, true, 0);
+}
+
+// Resets the library buffer to its initial value
+void tiny_reset() {
+    bool grown = tiny.grown;
+    release_grown();
+    release_owned();
+    #ifdef TINY_BUFFER
+    tiny.buffer = (tiny_block *)&tiny_buffer.buffer;
+    tiny.size = (TINY_BUFFER / ALIGNMENT - 2 * HEADER_BLOCKS);
+    tiny.base = (unsigned char *)&tiny_buffer;
+    tiny.base_end = tiny.base + sizeof(tiny_buffer);
+    if(grown) {
+        // The end marker may have been turned into a bridge
+        write_header(&tiny.buffer[0], tiny.size, false, 0);
+        write_header(&tiny.buffer[tiny.size + HEADER_BLOCKS], 0, true, 0);
+    }
+    #else
+    (void)grown;
+    tiny.buffer = NULL;
+    tiny.size = 0;
+    tiny.base = tiny.base_end = NULL;
+    #endif
+    tiny.stamps = NULL;
+    recount(true);
+    store_operation(TINY_RESET, true, tiny.size);
+}
+
+// Sets the out-of-memory flag status. If set, calls to `malloc` and similar will
+// return NULL always.
+void tiny_out_of_memory(bool out_of_memory) {
+    tiny.out_of_memory = out_of_memory;
+}
+
+// Returns the last operation performed by the library.
+tiny_operation tiny_last_operation() {
+    return tiny.last_operation;
+}
+
+// Gets the size of each block in the buffer (also, the library alignment)
+size_t tiny_block_size() { return ALIGNMENT; }
+
+// Installs event hooks. Passing NULL removes any installed hooks.
+// The hooks structure is not copied and must outlive its installation.
+void tiny_set_hooks(const tiny_hooks *hooks) {
+    tiny.hooks = hooks;
+}
+
+#ifdef TINY_POSIX
+// Writes a whole buffer to a file descriptor, retrying on partial writes
+static bool write_all(int fd, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    while(length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if(written <= 0) {
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+#endif
+
+// How many snapshot records are buffered on the stack before being written
+enum { SNAPSHOT_BATCH = 64 };
+
+// Writes a binary snapshot of the heap layout to a file descriptor.
+// Sections are streamed in batches from a stack buffer, so this may be called
+// when the heap is exhausted, e.g. from an out-of-memory hook.
+bool tiny_snapshot(int fd) {
+    #ifdef TINY_POSIX
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        bool written = false;
+        if(lock_shared()) {
+            written = tiny_snapshot(fd);
+            unlock_shared();
+        }
+        return written;
+    }
+    tiny_snapshot_header header = {
+        TINY_SNAPSHOT_MAGIC,
+        TINY_SNAPSHOT_VERSION,
+        ALIGNMENT,
+        HEADER_BLOCKS,
+        tiny.last_operation.function,
+        tiny.last_operation.success,
+        0,
+        tiny.last_operation.size,
+        (uintptr_t)tiny.buffer,
+        tiny.size,
+        tiny.buffer ? tiny.counters.sections.total : 0
+    };
+    if(!write_all(fd, &header, sizeof(header))) {
+        return false;
+    }
+    if(tiny.buffer == NULL) {
+        return true;
+    }
+
+    tiny_snapshot_record records[SNAPSHOT_BATCH];
+    size_t count = 0;
+    tiny_block *current = &tiny.buffer[0];
+    tiny_block_section section = read_header(current);
+    while(section.size > 0) {
+        if(section.bridge) {
+            current = next_section(current);
+            section = read_header(current);
+            continue;
+        }
+        tiny_snapshot_record record = {
+            (uint64_t)(current - tiny.buffer),
+            section.size,
+            section.taken ? TINY_SNAPSHOT_TAKEN : 0,
+            section.tag
+        };
+        records[count++] = record;
+        if(count == SNAPSHOT_BATCH) {
+            if(!write_all(fd, records, sizeof(records))) {
+                return false;
+            }
+            count = 0;
+        }
+        current = next_section(current);
+        section = read_header(current);
+    }
+    return write_all(fd, records, count * sizeof(records[0]));
+    #else
+    (void)fd;
+    return false;
+    #endif
+}
+
+// Starts profiling allocation lifetimes, measured in allocation epochs: how
+// many allocations happened between a section being taken and freed.
+// Stamps are kept in a caller-supplied side table with an entry per block,
+// so section headers are left untouched. Passing NULL stops profiling.
+bool tiny_profile_lifetimes(uint64_t *stamps, size_t count) {
+    if(stamps != NULL && (tiny.buffer == NULL || count < tiny.size)) {
+        return false;
+    }
+    for(size_t i = 0; i < count && stamps != NULL; i++) {
+        stamps[i] = UNSTAMPED;
+    }
+    tiny_lifetimes empty = { 0 };
+    tiny.lifetimes = empty;
+    tiny.stamps = stamps;
+    tiny.stamp_count = stamps ? count : 0;
+    return true;
+}
+
+// Returns the lifetime histograms, bucketed first by section size and then by
+// lifetime, both in powers of two
+tiny_lifetimes tiny_inspect_lifetimes() {
+    return tiny.lifetimes;
+}
+
+// Sets the tag given to allocations made by the calling thread that are not
+// explicitly tagged. Returns the previous tag, so it can be restored when the
+// scope ends. Tags out of range are ignored, like `tiny_malloc_tagged()`
+// refuses them, so the current tag is kept and returned.
+unsigned tiny_tag_scope(unsigned tag) {
+    unsigned previous = current_tag;
+    if(tag < TINY_TAGS) {
+        current_tag = tag;
+    }
+    return previous;
+}
+
+// Returns the running statistics of a tag without walking the heap
+tiny_tag_stats tiny_inspect_tag(unsigned tag) {
+    if(tag >= TINY_TAGS) {
+        tiny_tag_stats empty = { { 0, 0 }, { 0, 0 }, 0 };
+        return empty;
+    }
+    return make_tag_stats(tag);
+}
+
+// Allows the heap to grow when exhausted. Missing callbacks default to
+// obtaining and releasing memory with mmap. Passing NULL stops growing; memory
+// already obtained stays in the heap. Heaps kept in files or shared memory
+// never grow, as the chunks would be private to the process.
+void tiny_set_growth(const tiny_growth *growth) {
+    if(growth == NULL) {
+        tiny.growable = false;
+        return;
+    }
+    if(tiny.file != NULL) {
+        return;
+    }
+    tiny.growth = *growth;
+    if(tiny.growth.grow == NULL) {
+        tiny.growth.grow = default_grow;
+        tiny.growth.release = default_release;
+    } else if(tiny.growth.release == NULL) {
+        tiny.growth.release = default_release;
+    }
+    tiny.growable = true;
+}
+
+// Sets the size from which allocations get their own mapping, outside the heap.
+// Passing 0 serves every allocation from the heap. Heaps kept in files or
+// shared memory serve every allocation, as the mappings would be private to
+// the process.
+void tiny_set_mmap_threshold(size_t threshold) {
+    if(tiny.file != NULL) {
+        return;
+    }
+    tiny.mmap_threshold = threshold;
+}
+
+// Sets the size from which blocks copied by `tiny_realloc()` or cleared by
+// `tiny_calloc()` bypass the caches. Passing 0 never bypasses them.
+void tiny_set_stream_threshold(size_t threshold) {
+    stream_threshold = threshold;
+}
+
+// Returns the memory of free sections to the system, keeping `pad` bytes free
+// at the end of the heap. The headers of free sections stay in place, and
+// their memory is obtained again, zeroed, when taken. Returns how many bytes
+// were purged.
+size_t tiny_trim(size_t pad) {
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        size_t purged = 0;
+        if(lock_shared()) {
+            purged = tiny_trim(pad);
+            unlock_shared();
+        }
+        return purged;
+    }
+    return purge_free_sections(false, 0, pad);
+}
+
+// Trims the free section at the end of the heap whenever memory is freed and
+// at least `threshold` bytes of it were taken since it was last trimmed,
+// keeping `pad` bytes. Passing 0 never trims.
+void tiny_set_trim_threshold(size_t threshold, size_t pad) {
+    tiny.trim_threshold = threshold;
+    tiny.trim_pad = pad;
+    tiny.trim_high = NULL;
+}
+
+// Purges free sections once they have stayed free for `decay_ms`
+// milliseconds. This is checked whenever memory is freed at least that long
+// after the previous check, and on `tiny_purge()`. Passing 0 never purges.
+bool tiny_set_decay(uint32_t decay_ms) {
+    if(decay_ms >= PURGED_BIT / 2 || ALIGNMENT < sizeof(uint32_t)) {
+        return false;
+    }
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        bool set = false;
+        if(lock_shared()) {
+            set = tiny_set_decay(decay_ms);
+            unlock_shared();
+        }
+        return set;
+    }
+    tiny.decay_clock = clock_ms();
+    tiny.decay = decay_ms;
+    if(decay_ms != 0) {
+        stamp_free_sections(tiny.decay_clock);
+    }
+    return true;
+}
+
+// Purges the free sections that have decayed. Returns how many bytes were
+// purged.
+size_t tiny_purge() {
+    if(tiny.decay == 0) {
+        return 0;
+    }
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        size_t purged = 0;
+        if(lock_shared()) {
+            purged = tiny_purge();
+            unlock_shared();
+        }
+        return purged;
+    }
+    return purge_free_sections(true, clock_ms(), 0);
+}
+
+// Zeroes free sections not known to be zeroed yet, so that `tiny_calloc()` does
+// not clear them when they are taken. Sections are zeroed whole, from the start
+// of the heap, skipping those that would take more than `limit` bytes written
+// in all. Returns how many bytes were written.
+size_t tiny_prezero(size_t limit) {
+    if(tiny.buffer == NULL || tiny.file != NULL || tiny.shared != NULL) {
+        return 0;
+    }
+    size_t zeroed = 0;
+    tiny_block *header = &tiny.buffer[0];
+    tiny_block_section section = read_header(header);
+    while(section.size > 0) {
+        tiny_block *next = next_section(header);
+        if(!section.taken && !section.zero) {
+            unsigned char *first = (unsigned char *)(header + HEADER_BLOCKS + 1);
+            unsigned char *end = (unsigned char *)next;
+            // Decommitted memory already reads as zeros
+            unsigned char *gap = end, *gap_end = end;
+            if(tiny.reserved != NULL && first < tiny.reserved_tail && end > tiny.committed) {
+                gap = first > tiny.committed ? first : tiny.committed;
+                gap_end = end < tiny.reserved_tail ? end : tiny.reserved_tail;
+            }
+            size_t length = (size_t)(end - first) - (size_t)(gap_end - gap);
+            if(length <= limit - zeroed) {
+                // Nothing is about to read them, so they bypass the caches
+                zero_blocks(first, gap - first, true);
+                zero_blocks(gap_end, end - gap_end, true);
+                mark_zero(header);
+                zeroed += length;
+            }
+        }
+        header = next;
+        section = read_header(header);
+    }
+    return zeroed;
+}
+
+// Returns the last section of the heap if it is free
+static tiny_block *free_tail(void) {
+    tiny_block *tail = NULL;
+    tiny_block *header = tiny.buffer;
+    if(header == NULL) {
+        return NULL;
+    }
+    tiny_block_section section = read_header(header);
+    while(section.size > 0) {
+        tail = section.taken ? NULL : header;
+        header = next_section(header);
+        section = read_header(header);
+    }
+    return tail;
+}
+
+// Returns the pages of the free section at the end of the heap that were taken
+// since the last trim to the system, once they add up to the trim threshold
+static void trim_tail(void) {
+    tiny_block *tail = free_tail();
+    if(tail == NULL) {
+        return;
+    }
+    unsigned char *start = page_up((unsigned char *)(tail + HEADER_BLOCKS) + tiny.trim_pad);
+    unsigned char *keep = page_up(tail + HEADER_BLOCKS + 1);
+    if(start < keep) {
+        start = keep;
+    }
+    if(tiny.trim_high <= start || (size_t)(tiny.trim_high - start) < tiny.trim_threshold) {
+        return;
+    }
+    unsigned char *end = page_up(tiny.trim_high);
+    unsigned char *limit = page_down(next_section(tail));
+    if(end > limit) {
+        end = limit;
+    }
+    // Pages that could not be discarded, as locked ones, are not tried again
+    // until as much is taken anew
+    if(start < end) {
+        discard_pages(start, end);
+    }
+    tiny.trim_high = start;
+}
+
+// Faults in the first bytes of the free section at the end of the heap, where
+// allocations go once the sections before it are taken. Reserved memory is
+// committed and, if the section is smaller than that, the heap is grown first.
+// This changes the heap as allocating does, so it must run on the thread that
+// uses the context, e.g. between requests, never alongside other calls.
+// Returns how many bytes were faulted in.
+size_t tiny_prefault(size_t size) {
+    if(tiny.buffer == NULL && !tiny.growable) {
+        return 0;
+    }
+    size_t blocks = ALIGN_SIZE(size) / ALIGNMENT;
+    if(ALIGN_SIZE(size) < size) {
+        return 0;
+    }
+
+    tiny_block *tail = free_tail();
+    if((tail == NULL || read_header(tail).size < blocks) && grow_heap(blocks)) {
+        tail = free_tail();
+    }
+    if(tail == NULL) {
+        return 0;
+    }
+
+    tiny_block_section section = read_header(tail);
+    unsigned char *start = (unsigned char *)section.data;
+    if(blocks > section.size) {
+        blocks = section.size;
+    }
+    unsigned char *end = start + blocks * ALIGNMENT;
+    if(UNLIKELY(tiny.reserved != NULL) && !commit_section(tail, section.size, blocks)) {
+        return 0;
+    }
+    populate(start, end);
+    return end - start;
+}
+
+// Releases free memory at the end of the heap that was obtained by growing.
+// Whole regions are released while they are entirely free, and then the
+// trailing pages of the last free section. Returns how many bytes were
+// released.
+size_t tiny_shrink() {
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        size_t released = 0;
+        if(lock_shared()) {
+            released = tiny_shrink();
+            unlock_shared();
+        }
+        return released;
+    }
+    if(!tiny.grown || tiny.buffer == NULL) {
+        return 0;
+    }
+
+    size_t released = 0;
+    for(;;) {
+        // Finds the last section, the start of the last region and the
+        // bridge that leads to it
+        tiny_block *bridge = NULL, *region = &tiny.buffer[0], *last = NULL;
+        tiny_block *header = region;
+        tiny_block_section section = read_header(header);
+        while(section.size > 0) {
+            if(section.bridge) {
+                bridge = header;
+                region = next_section(header);
+                last = NULL;
+            } else {
+                last = header;
+            }
+            header = next_section(header);
+            section = read_header(header);
+        }
+        if(last == NULL) {
+            break;
+        }
+        tiny_block_section tail = read_header(last);
+        if(tail.taken) {
+            break;
+        }
+
+        unsigned char *start = (unsigned char *)region;
+        unsigned char *end = (unsigned char *)(header + HEADER_BLOCKS);
+        bool overlaps_base = start < tiny.base_end && end > tiny.base;
+        if(last == region && bridge != NULL && !overlaps_base) {
+            // The whole region is free: the bridge becomes the end marker
+            uncount_section(tail.size, false, 0);
+            write_header(bridge, 0, true, 0);
+            tiny.size -= tail.size + HEADER_BLOCKS;
+            released += release_range(start, end);
+            forget_grown_from(start, end);
+            continue;
+        }
+
+        // Keeps the header of the last section, a block and a new end marker
+        unsigned char *floor = page_up(last + 2 * HEADER_BLOCKS + 1);
+        if(overlaps_base && floor < page_up(tiny.base_end)) {
+            floor = page_up(tiny.base_end);
+        }
+        if(floor >= page_down(end)) {
+            break;
+        }
+        tiny_block *marker = (tiny_block *)floor - HEADER_BLOCKS;
+        size_t size = marker - last - HEADER_BLOCKS;
+        uncount_section(tail.size, false, 0);
+        count_section(size, false, 0);
+        tiny.size -= tail.size - size;
+        write_header(last, size, false, 0);
+        write_header(marker, 0, true, 0);
+        released += release_range(floor, end);
+        forget_grown_from(floor, end);
+        break;
+    }
+
+    if(released > 0) {
+        tiny.counters.largest_free = largest_free_from(&tiny.buffer[0]);
+        tiny.counters.largest_stale = false;
+    }
+    return released;
+}
+
+// Returns the running statistics of the library. Unlike `tiny_inspect()`,
+// this does not walk the heap.
+tiny_stats tiny_statistics() {
+    return make_stats();
+}
+
+// Starts publishing statistics to a shared memory segment, so external
+// monitors can read them. Passing NULL stops publishing and removes the
+// segment.
+bool tiny_publish(const char *name) {
+    #ifdef TINY_POSIX
+    if(tiny.stats_page != NULL) {
+        munmap(tiny.stats_page, sizeof(tiny_stats_page));
+        shm_unlink(tiny.stats_name);
+        tiny.stats_page = NULL;
+    }
+    if(name == NULL) {
+        return true;
+    }
+
+    size_t length = strlen(name);
+    if(length >= sizeof(tiny.stats_name)) {
+        return false;
+    }
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    void *page = MAP_FAILED;
+    if(ftruncate(fd, sizeof(tiny_stats_page)) == 0) {
+        page = mmap(
+            NULL, sizeof(tiny_stats_page), 
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+        );
+    }
+    close(fd);
+    if(page == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+
+    memcpy(tiny.stats_name, name, length + 1);
+    tiny.stats_page = page;
+    tiny.stats_page->magic = TINY_STATS_MAGIC;
+    tiny.stats_page->version = TINY_STATS_VERSION;
+    tiny.stats_page->pid = (long)getpid();
+    tiny.stats_countdown = 0;
+    publish_stats(tiny.last_operation.function, true);
+    return true;
+    #else
+    return name == NULL;
+    #endif
+}
+
+
+// Size of the stack buffer used to format dumps
+enum { EMIT_BUFFER_SIZE = 256 };
+
+// Formats dumps into a fixed stack buffer that is flushed to a sink, so no
+// memory is ever allocated while the heap is being walked
+typedef struct tiny_emitter {
+    tiny_sink sink; // Receives the formatted output
+    void *context; // Passed back to the sink
+    tiny_dump_format format; // Whether to emit text or JSON
+    bool separate; // Whether a JSON member separator is due
+    size_t length; // How many characters are pending in the buffer
+    char buffer[EMIT_BUFFER_SIZE]; // The pending output
+} tiny_emitter;
+
+// Sends any pending output to the sink
+static void emit_flush(tiny_emitter *out) {
+    if(out->length > 0) {
+        out->sink(out->context, out->buffer, out->length);
+        out->length = 0;
+    }
+}
+
+static void emit_char(tiny_emitter *out, char c) {
+    if(out->length == EMIT_BUFFER_SIZE) {
+        emit_flush(out);
+    }
+    out->buffer[out->length++] = c;
+}
+
+static void emit_string(tiny_emitter *out, const char *str) {
+    while(*str) {
+        emit_char(out, *str++);
+    }
+}
+
+static void emit_unsigned(tiny_emitter *out, uintmax_t value, unsigned base) {
+    char digits[sizeof(uintmax_t) * 8];
+    size_t count = 0;
+    do {
+        digits[count++] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while(value > 0);
+    while(count > 0) {
+        emit_char(out, digits[--count]);
+    }
+}
+
+static void emit_pointer(tiny_emitter *out, const void *ptr) {
+    if(ptr == NULL) {
+        emit_string(out, out->format == TINY_JSON ? "null" : "(nil)");
+        return;
+    }
+    emit_string(out, out->format == TINY_JSON ? "\"0x" : "0x");
+    emit_unsigned(out, (uintptr_t)ptr, 16);
+    if(out->format == TINY_JSON) {
+        emit_char(out, '"');
+    }
+}
+
+// Starts a JSON member, preceded by a separator if needed
+static void emit_key(tiny_emitter *out, const char *key) {
+    if(out->separate) {
+        emit_char(out, ',');
+    }
+    emit_char(out, '"');
+    emit_string(out, key);
+    emit_string(out, "\":");
+    out->separate = true;
+}
+
+// Opens a JSON object or array, as a member if `key` is given
+static void emit_open(tiny_emitter *out, const char *key, char bracket) {
+    if(key) {
+        emit_key(out, key);
+    } else if(out->separate) {
+        emit_char(out, ',');
+    }
+    emit_char(out, bracket);
+    out->separate = false;
+}
+
+static void emit_close(tiny_emitter *out, char bracket) {
+    emit_char(out, bracket);
+    out->separate = true;
+}
+
+// Starts a text line or a JSON member
+static void emit_label(tiny_emitter *out, const char *label, const char *key) {
+    if(out->format == TINY_JSON) {
+        emit_key(out, key);
+    } else {
+        emit_string(out, label);
+        emit_string(out, ": ");
+    }
+}
+
+static void emit_size_field(tiny_emitter *out, const char *label, const char *key, size_t value) {
+    emit_label(out, label, key);
+    emit_unsigned(out, value, 10);
+    if(out->format == TINY_TEXT) {
+        emit_char(out, '\n');
+    }
+}
 
-    if(lost_alignment + (2 * HEADER_BLOCKS + 1) * ALIGNMENT >= size) {
-        store_operation(TINY_INIT, false, size);
-        return;
-    } 
+static void emit_blocks_field(tiny_emitter *out, const char *label, const char *key, tiny_size size) {
+    if(out->format == TINY_JSON) {
+        emit_open(out, key, '{');
+        emit_size_field(out, NULL, "blocks", size.blocks);
+        emit_size_field(out, NULL, "bytes", size.bytes);
+        emit_close(out, '}');
+    } else {
+        emit_label(out, label, key);
+        emit_unsigned(out, size.blocks, 10);
+        emit_string(out, " blocks (");
+        emit_unsigned(out, size.bytes, 10);
+        emit_string(out, " bytes)\n");
+    }
+}
 
-    tiny.buffer = (tiny_block *)aligned;
-    tiny.size = (size - lost_alignment) / ALIGNMENT - 2 * HEADER_BLOCKS;
+static void emit_pointer_field(tiny_emitter *out, const char *label, const char *key, const void *ptr) {
+    emit_label(out, label, key);
+    if(out->format == TINY_JSON) {
+        emit_pointer(out, ptr);
+    } else {
+        emit_char(out, '[');
+        emit_pointer(out, ptr);
+        emit_string(out, "]\n");
+    }
+}
 
-    write_header(&tiny.buffer[0], tiny.size, false);
-    write_header(&tiny.buffer[tiny.size + HEADER_BLOCKS], 0, true);
-    store_operation(TINY_INIT, true, size);
+static void emit_string_field(tiny_emitter *out, const char *label, const char *key, const char *value) {
+    emit_label(out, label, key);
+    if(out->format == TINY_JSON) {
+        emit_char(out, '"');
+        emit_string(out, value);
+        emit_char(out, '"');
+    } else {
+        emit_string(out, value);
+        emit_char(out, '\n');
+    }
 }
 
-// Clears the library buffer
-void tiny_clear() {
-    tiny.buffer = NULL;
-    tiny.size = 0;
-    store_operation(TINY_CLEAR, true, 0);
+// Emits a boolean, described by `yes` or `no` in text form
+static void emit_bool_field(
+    tiny_emitter *out, const char *label, const char *key, 
+    bool value, const char *yes, const char *no
+) {
+    emit_label(out, label, key);
+    if(out->format == TINY_JSON) {
+        emit_string(out, value ? "true" : "false");
+    } else {
+        emit_string(out, value ? yes : no);
+        emit_char(out, '\n');
+    }
 }
 
-// Resets the library buffer to its initial value
-void tiny_reset() {
-    #ifdef TINY_BUFFER
-    tiny.buffer = (tiny_block *)&tiny_buffer.buffer;
-    tiny.size = (TINY_BUFFER / ALIGNMENT - 2 * HEADER_BLOCKS);
-    #else
-    tiny.buffer = NULL;
-    tiny.size = 0;
-    #endif
-    store_operation(TINY_RESET, true, tiny.size);
+// Emits a section title in text form or opens a JSON member
+static void emit_title(tiny_emitter *out, const char *title, const char *key, char bracket) {
+    if(out->format == TINY_JSON) {
+        emit_open(out, key, bracket);
+    } else {
+        emit_string(out, "\n|  ");
+        emit_string(out, title);
+        emit_string(out, "  |\n\n");
+    }
 }
 
-// Sets the out-of-memory flag status. If set, calls to `malloc` and similar will
-// return NULL always.
-void tiny_out_of_memory(bool out_of_memory) {
-    tiny.out_of_memory = out_of_memory;
+static void emit_end(tiny_emitter *out, char bracket) {
+    if(out->format == TINY_JSON) {
+        emit_close(out, bracket);
+    }
 }
 
-// Returns the last operation performed by the library.
-tiny_operation tiny_last_operation() {
-    return tiny.last_operation;
+// Emits the running statistics of every tag that was ever allocated with
+static void emit_tags(tiny_emitter *out) {
+    if(out->format == TINY_JSON) {
+        emit_open(out, "tags", '[');
+    }
+    for(unsigned tag = 0; tag < TINY_TAGS; tag++) {
+        tiny_tag_stats stats = make_tag_stats(tag);
+        if(stats.allocations == 0) {
+            continue;
+        }
+        if(out->format == TINY_JSON) {
+            emit_open(out, NULL, '{');
+            emit_size_field(out, NULL, "tag", tag);
+            emit_blocks_field(out, NULL, "live", stats.live);
+            emit_blocks_field(out, NULL, "peak", stats.peak);
+            emit_size_field(out, NULL, "allocations", stats.allocations);
+            emit_close(out, '}');
+        } else {
+            emit_string(out, "Tag ");
+            emit_unsigned(out, tag, 10);
+            emit_string(out, ": ");
+            emit_unsigned(out, stats.live.bytes, 10);
+            emit_string(out, " bytes live, ");
+            emit_unsigned(out, stats.peak.bytes, 10);
+            emit_string(out, " bytes at peak, ");
+            emit_unsigned(out, stats.allocations, 10);
+            emit_string(out, " allocations\n");
+        }
+    }
+    if(out->format == TINY_JSON) {
+        emit_close(out, ']');
+    }
 }
 
-// Gets the size of each block in the buffer (also, the library alignment)
-size_t tiny_block_size() { return ALIGNMENT; }
+static void emit_summary(tiny_emitter *out) {
+    tiny_summary summ = tiny_inspect();
+    emit_title(out, "Tiny summary", "summary", '{');
+    emit_size_field(out, "Alignment", "alignment", summ.alignment);
+    emit_string_field(out, "Alignment type alias", "aligned_type", summ.aligned_type);
+    emit_pointer_field(out, "Static buffer", "static_buffer", summ.static_buffer);
+    emit_size_field(out, "Static buffer size", "static_buffer_size", summ.static_buffer_size);
+    emit_bool_field(out, "Forced out-of-memory", "out_of_memory", summ.out_of_memory, "yes", "no");
+    emit_pointer_field(out, "Buffer", "buffer", summ.buffer);
+    emit_blocks_field(out, "Buffer size", "total", summ.total);
+    emit_size_field(out, "Page size", "page_size", summ.page_size);
+    emit_blocks_field(out, "Free memory", "free", summ.free);
+    emit_blocks_field(out, "Taken memory", "taken", summ.taken);
+    if(out->format == TINY_JSON) {
+        emit_open(out, "sections", '{');
+        emit_size_field(out, NULL, "total", summ.sections.total);
+        emit_size_field(out, NULL, "free", summ.sections.free);
+        emit_size_field(out, NULL, "taken", summ.sections.taken);
+        emit_close(out, '}');
+    } else {
+        emit_string(out, "Sections: ");
+        emit_unsigned(out, summ.sections.total, 10);
+        emit_string(out, " in total, ");
+        emit_unsigned(out, summ.sections.free, 10);
+        emit_string(out, " free, ");
+        emit_unsigned(out, summ.sections.taken, 10);
+        emit_string(out, " taken\n");
+    }
+    emit_tags(out);
+    emit_end(out, '}');
+}
 
+static void emit_last_operation(tiny_emitter *out) {
+    emit_title(out, "Last tiny operation", "last_operation", '{');
+    emit_string_field(out, "Operation", "function", operations[tiny.last_operation.function]);
+    emit_bool_field(
+        out, "Status", "success", 
+        tiny.last_operation.success, "success", "failure"
+    );
+    emit_size_field(out, "Size", "size", tiny.last_operation.size);
+    emit_end(out, '}');
+}
 
-// Prints a summary of the library
-void tiny_print(bool summary, bool last_op, bool heap) {
-    printf("\n");
-    if(summary) {
-        tiny_summary summ = tiny_inspect();
-        printf(
-            "\n|  Tiny summary  |\n\n"
-            "Alignment: %lu\n"
-            "Alignment type alias: %s\n"
-            "Static buffer: [%p]\n"
-            "Static buffer size: %lu\n"
-            "Forced out-of-memory: %s\n"
-            "Buffer: [%p]\n"
-            "Buffer size: %lu blocks (%lu bytes)\n"
-            "Free memory: %lu blocks (%lu bytes)\n"
-            "Taken memory: %lu blocks (%lu bytes)\n"
-            "Sections: %lu in total, %lu free, %lu taken\n",
-            summ.alignment,
-            summ.aligned_type,
-            summ.static_buffer,
-            summ.static_buffer_size,
-            summ.out_of_memory ? "yes" : "no",
-            summ.buffer,
-            summ.total.blocks, summ.total.bytes,
-            summ.free.blocks, summ.free.bytes,
-            summ.taken.blocks, summ.taken.bytes,
-            summ.sections.total, summ.sections.free, summ.sections.taken
-        );
+// Walks the heap, emitting each section as it is reached
+static void emit_heap(tiny_emitter *out) {
+    if(tiny.buffer == NULL || tiny.size == 0) {
+        if(out->format == TINY_JSON) {
+            emit_key(out, "heap");
+            emit_string(out, "null");
+        } else {
+            emit_title(out, "Tiny heap", "heap", '[');
+            emit_string(out, "Heap not allocated\n");
+        }
+        return;
     }
 
-    if(last_op) {
-        printf(
-            "\n|  Last tiny operation  |\n\n"
-            "Operation: %s\n"
-            "Status: %s\n"
-            "Size: %lu\n", 
-            operations[tiny.last_operation.function], 
-            tiny.last_operation.success ? "success" : "failure",
-            tiny.last_operation.size
-        );
+    emit_title(out, "Tiny heap", "heap", '[');
+    tiny_block *header = &tiny.buffer[0];
+    tiny_block_section info = read_header(header);
+    size_t i = 0;
+    while(info.size > 0) {
+        if(info.bridge) {
+            header = next_section(header);
+            info = read_header(header);
+            continue;
+        }
+        tiny_size size = { info.size, info.size * ALIGNMENT };
+        if(out->format == TINY_JSON) {
+            emit_open(out, NULL, '{');
+        } else {
+            emit_string(out, "Section ");
+            emit_unsigned(out, i, 10);
+            emit_string(out, ":\n");
+        }
+        emit_bool_field(out, "    Taken", "taken", info.taken, "yes", "no");
+        emit_blocks_field(out, "    Size", "size", size);
+        emit_pointer_field(out, "    Header adddress", "header", info.header);
+        emit_pointer_field(out, "    Data address", "data", info.data);
+        emit_size_field(out, "    Tag", "tag", info.tag);
+        emit_end(out, '}');
+        i++;
+        header = next_section(header);
+        info = read_header(header);
+    } 
+    if(out->format == TINY_TEXT) {
+        emit_string(out, "No more sections\n");
     }
+    emit_end(out, ']');
+}
 
-    if(heap) {
-        printf("\n|  Tiny heap  |\n\n");
-        if(tiny.buffer == NULL || tiny.size == 0) {
-            printf("Heap not allocated\n");
+// Emits the lifetime histograms of every size bucket that had sections freed
+static void emit_lifetimes(tiny_emitter *out) {
+    emit_title(out, "Tiny lifetimes", "lifetimes", '{');
+    emit_size_field(out, "Allocation epoch", "epoch", tiny.lifetimes.epoch);
+    if(out->format == TINY_JSON) {
+        emit_open(out, "sizes", '[');
+    }
+    for(size_t i = 0; i < TINY_LIFETIME_SIZES; i++) {
+        const tiny_lifetime_size *size = &tiny.lifetimes.sizes[i];
+        if(size->freed == 0) {
+            continue;
+        }
+        if(out->format == TINY_JSON) {
+            emit_open(out, NULL, '{');
+            emit_size_field(out, NULL, "min_blocks", (size_t)1 << i);
+            emit_size_field(out, NULL, "freed", size->freed);
+            emit_size_field(out, NULL, "total_lifetime", size->total_lifetime);
+            emit_open(out, "histogram", '[');
+            for(size_t j = 0; j < TINY_LIFETIME_BUCKETS; j++) {
+                if(j > 0) {
+                    emit_char(out, ',');
+                }
+                emit_unsigned(out, size->histogram[j], 10);
+            }
+            emit_close(out, ']');
+            emit_close(out, '}');
         } else {
-            tiny_block *header = &tiny.buffer[0];
-            tiny_block_section info = read_header(header);
-            size_t i = 0;
-            while(info.size > 0) {
-                printf(
-                    "Section %lu:\n"
-                    "    Taken: %s\n"
-                    "    Size: %lu blocks (%lu bytes)\n"
-                    "    Header adddress: [%p]\n"
-                    "    Data address: [%p]\n",
-                    i++,
-                    info.taken ? "yes" : "no",
-                    info.size, info.size * ALIGNMENT,
-                    (void *)info.header,
-                    info.data
-                );
-                header = next_section(header);
-                info = read_header(header);
-            } 
-            printf("No more sections\n");
+            emit_string(out, "Sections of ");
+            emit_unsigned(out, (size_t)1 << i, 10);
+            emit_string(out, i < TINY_LIFETIME_SIZES - 1 ? "-" : "+");
+            if(i < TINY_LIFETIME_SIZES - 1) {
+                emit_unsigned(out, ((size_t)2 << i) - 1, 10);
+            }
+            emit_string(out, " blocks: ");
+            emit_unsigned(out, size->freed, 10);
+            emit_string(out, " freed, mean lifetime ");
+            emit_unsigned(out, size->total_lifetime / size->freed, 10);
+            emit_string(out, "\n   ");
+            for(size_t j = 0; j < TINY_LIFETIME_BUCKETS; j++) {
+                if(size->histogram[j] > 0) {
+                    emit_string(out, " <");
+                    emit_unsigned(out, (uintmax_t)2 << j, 10);
+                    emit_string(out, ": ");
+                    emit_unsigned(out, size->histogram[j], 10);
+                }
+            }
+            emit_char(out, '\n');
+        }
+    }
+    if(out->format == TINY_JSON) {
+        emit_close(out, ']');
+    }
+    emit_end(out, '}');
+}
+
+// Dumps information of the library into a sink without allocating memory
+void tiny_dump(tiny_sink sink, void *context, unsigned flags, tiny_dump_format format) {
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        if(lock_shared()) {
+            tiny_dump(sink, context, flags, format);
+            unlock_shared();
         }
+        return;
+    }
+    tiny_emitter out = { sink, context, format, false, 0, { 0 } };
+    if(format == TINY_JSON) {
+        emit_open(&out, NULL, '{');
+    }
+    if(flags & TINY_DUMP_SUMMARY) {
+        emit_summary(&out);
+    }
+    if(flags & TINY_DUMP_LAST_OP) {
+        emit_last_operation(&out);
     }
+    if(flags & TINY_DUMP_HEAP) {
+        emit_heap(&out);
+    }
+    if((flags & TINY_DUMP_LIFETIMES) && tiny.stamps != NULL) {
+        emit_lifetimes(&out);
+    }
+    if(format == TINY_JSON) {
+        emit_close(&out, '}');
+        emit_char(&out, '\n');
+    }
+    emit_flush(&out);
+}
+
+// Writes dumped output to the standard output
+static void print_sink(void *context, const char *data, size_t length) {
+    (void)context;
+    fwrite(data, 1, length, stdout);
+}
+
+// Prints a summary of the library
+void tiny_print(bool summary, bool last_op, bool heap) {
+    unsigned flags = 
+        (summary ? TINY_DUMP_SUMMARY | TINY_DUMP_LIFETIMES : 0) |
+        (last_op ? TINY_DUMP_LAST_OP : 0) |
+        (heap ? TINY_DUMP_HEAP : 0);
+    print_sink(NULL, "\n", 1);
+    tiny_dump(print_sink, NULL, flags, TINY_TEXT);
 }
 
 
 tiny_summary tiny_inspect() {
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        tiny_summary summary = { 0 };
+        if(lock_shared()) {
+            summary = tiny_inspect();
+            unlock_shared();
+        }
+        return summary;
+    }
     #ifdef TINY_BUFFER 
     void *static_buffer = (void *)&tiny_buffer;
     size_t static_buffer_size = TINY_BUFFER;
@@ -293,6 +3223,11 @@ tiny_summary tiny_inspect() {
     if(header) {
         tiny_block_section section = read_header(header);
         while(section.size > 0) {
+            if(section.bridge) {
+                header = next_section(header);
+                section = read_header(header);
+                continue;
+            }
             total_sections++;
             if(section.taken) {
                 taken_sections++;
@@ -316,15 +3251,76 @@ tiny_summary tiny_inspect() {
         { tiny.size, tiny.size * ALIGNMENT },
         { free_blocks, free_blocks * ALIGNMENT },
         { taken_blocks, taken_blocks * ALIGNMENT },
-        { total_sections, free_sections, taken_sections }
+        { total_sections, free_sections, taken_sections },
+        { { { 0, 0 }, { 0, 0 }, 0 } },
+        heap_page()
     };
+    for(unsigned tag = 0; tag < TINY_TAGS; tag++) {
+        summ.tags[tag] = make_tag_stats(tag);
+    }
     return summ;
 }
 
 
+// Frees memory whose size is known, checking it against the section it is in.
+// A section never holds a whole header more than was asked for, so memory
+// whose size does not match is left as it is and the operation fails.
+void tiny_free_sized(void *ptr, size_t size) {
+    if(ptr != NULL) {
+        size_t usable = tiny_usable_size(ptr);
+        if(
+            size > usable || 
+            (!is_mapped(ptr) && usable - ALIGN_SIZE(size) > HEADER_BLOCKS * ALIGNMENT)
+        ) {
+            store_operation(TINY_FREE, false, size);
+            return;
+        }
+    }
+    tiny_free(ptr);
+}
+
+// Returns whether a pointer lies in one of the ranges a heap grew by
+static bool in_grown_range(const struct tiny_context *context, const unsigned char *address) {
+    for(size_t i = 0; i < context->grown_range_count; i++) {
+        if(address >= context->grown_ranges[i].start && address < context->grown_ranges[i].end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns whether a pointer was allocated by the heap, or by that of any NUMA
+// node. Pointers in the initial buffer and in memory the heap grew by are
+// recognised by their address alone, and allocations with their own mapping
+// by their headers, which are only read when they would lie on the page of
+// the pointer. Other memory around it is never read.
+bool tiny_owns(const void *ptr) {
+    const unsigned char *address = ptr;
+    if(ptr == NULL) {
+        return false;
+    }
+    const struct tiny_context *context = UNLIKELY(tiny_node_count > 1) ?
+        owner_of((void *)ptr) : tiny_heap;
+    if(address >= context->base && address < context->base_end) {
+        return true;
+    }
+    return in_grown_range(context, address) || owns_mapping(ptr);
+}
+
+// Returns how many bytes may be used at some allocated memory
+size_t tiny_usable_size(void *ptr) {
+    if(ptr == NULL) {
+        return 0;
+    }
+    if(UNLIKELY(is_mapped(ptr))) {
+        return mapping_capacity(mapping_length(ptr));
+    }
+    return read_header((tiny_block *)ptr - HEADER_BLOCKS).size * ALIGNMENT;
+}
+
 tiny_section tiny_next_section(void *previous_header) {
     if(tiny.buffer == NULL) {
-        tiny_section info = { false, NULL, NULL, { 0, 0 } };
+        tiny_section info = { false, NULL, NULL, { 0, 0 }, 0 };
         return info;    
     }
 
@@ -332,53 +3328,171 @@ tiny_section tiny_next_section(void *previous_header) {
         next_section(previous_header) : 
         &tiny.buffer[0];
     tiny_block_section section = read_header(header);
+    while(section.bridge) {
+        // Bridges only join regions, they are not sections of their own
+        header = next_section(header);
+        section = read_header(header);
+    }
     tiny_section info = {
         section.taken,
         section.size != 0 ? (void *)header : NULL,
         section.size != 0 ? (void *)(header + HEADER_BLOCKS) : NULL,
-        { section.size, section.size * ALIGNMENT }
+        { section.size, section.size * ALIGNMENT },
+        section.tag
     };
     return info;
 }
 
-void *tiny_malloc(size_t size) {
-    if(tiny.out_of_memory || tiny.buffer == NULL || size == 0) {
-        store_operation(TINY_MALLOC, false, size);
-        return NULL;
+void *(tiny_malloc)(size_t size) {
+    return tiny_malloc_tagged(size, current_tag);
+}
+
+// Takes a section of some blocks for a request of `size` bytes, checked and
+// rounded up to them
+static void *malloc_blocks(size_t blocks_required, size_t size, unsigned tag) {
+    if(UNLIKELY(tiny_node_count > 1) && numa_countdown-- == 0) {
+        route_thread();
     }
-    
-    size_t aligned_size = ALIGN_SIZE(size);
-    if(aligned_size < size) {
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        void *data = NULL;
+        if(lock_shared()) {
+            data = malloc_blocks(blocks_required, size, tag);
+            unlock_shared();
+        } else {
+            store_operation(TINY_MALLOC, false, size);
+        }
+        return data;
+    }
+
+    if(UNLIKELY(tiny.mmap_threshold != 0) && size >= tiny.mmap_threshold && !tiny.out_of_memory) {
+        void *data = map_allocation(size, tag);
+        if(data != NULL) {
+            tiny.last_zero = true;
+            tiny.counters.tags[tag].allocations++;
+            store_operation(TINY_MALLOC, true, size);
+            FIRE_HOOK(allocate, data, size);
+            return data;
+        }
+    }
+
+    bool no_heap = tiny.buffer == NULL && !tiny.growable;
+    if(tiny.out_of_memory || no_heap) {
         store_operation(TINY_MALLOC, false, size);
+        FIRE_HOOK(out_of_memory, TINY_MALLOC, size);
         return NULL;
     }
 
-    size_t blocks_required = aligned_size / ALIGNMENT;
-    tiny_block *header = &tiny.buffer[0];
-    tiny_block_section section = read_header(header);
+    size_t largest_before = 0;
+    tiny_block *header = tiny.buffer;
+    tiny_block_section section = { 0 };
+    if(header != NULL) {
+        section = read_header(header);
+    }
     while(section.size > 0) {
         if(!section.taken && section.size >= blocks_required) {
-            allocate_at(section, blocks_required);
+            if(!allocate_at(section, blocks_required, tag)) {
+                break;
+            }
+            tiny.counters.tags[tag].allocations++;
+            if(tiny.counters.largest_stale) {
+                // Every free section before this one was already visited
+                size_t largest_after = largest_free_from(header);
+                tiny.counters.largest_free = 
+                    largest_before > largest_after ? largest_before : largest_after;
+                tiny.counters.largest_stale = false;
+            }
+            if(UNLIKELY(tiny.stamps != NULL)) {
+                stamp_section(header);
+            }
             store_operation(TINY_MALLOC, true, size);
+            FIRE_HOOK(allocate, section.data, size);
             return section.data;
         }
+        if(!section.taken && section.size > largest_before) {
+            largest_before = section.size;
+        }
         header = next_section(header);
         section = read_header(header);
     } 
+    if(section.size == 0 && grow_heap(blocks_required)) {
+        return malloc_blocks(blocks_required, size, tag);
+    }
     store_operation(TINY_MALLOC, false, size);
+    FIRE_HOOK(out_of_memory, TINY_MALLOC, size);
     return NULL;
 }
 
+// Allocates memory attributed to a tag
+void *tiny_malloc_tagged(size_t size, unsigned tag) {
+    if(size == 0 || tag >= TINY_TAGS) {
+        store_operation(TINY_MALLOC, false, size);
+        return NULL;
+    }
+    size_t aligned_size = ALIGN_SIZE(size);
+    if(aligned_size < size) {
+        store_operation(TINY_MALLOC, false, size);
+        FIRE_HOOK(out_of_memory, TINY_MALLOC, size);
+        return NULL;
+    }
+    return malloc_blocks(aligned_size / ALIGNMENT, size, tag);
+}
+
+// Allocates memory for a size already rounded up to blocks, at compile time.
+// Only the rounding is skipped: the request is checked as by `tiny_malloc()`.
+void *tiny_malloc_blocks(size_t blocks, size_t size) {
+    if(
+        size == 0 || current_tag >= TINY_TAGS || 
+        blocks != ALIGN_SIZE(size) / ALIGNMENT || ALIGN_SIZE(size) < size
+    ) {
+        store_operation(TINY_MALLOC, false, size);
+        return NULL;
+    }
+    return malloc_blocks(blocks, size, current_tag);
+}
+
 void *tiny_realloc(void *ptr, size_t size) {
+    if(UNLIKELY(tiny_node_count > 1) && ptr != NULL && owner_of(ptr) != tiny_heap) {
+        struct tiny_context *previous = tiny_heap;
+        tiny_heap = owner_of(ptr);
+        void *data = tiny_realloc(ptr, size);
+        tiny_heap = previous;
+        return data;
+    }
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        void *data = NULL;
+        if(lock_shared()) {
+            data = tiny_realloc(ptr, size);
+            unlock_shared();
+        } else {
+            store_operation(TINY_REALLOC, false, size);
+        }
+        return data;
+    }
     if(ptr == NULL) {
         void *data = tiny_malloc(size);
         store_operation(TINY_REALLOC, data != NULL, size);
         return data;
     }
-    if(tiny.out_of_memory || tiny.buffer == NULL || size == 0) {
+    if(tiny.out_of_memory || size == 0 || (tiny.buffer == NULL && !is_mapped(ptr))) {
         store_operation(TINY_REALLOC, false, size);
+        if(size != 0) {
+            FIRE_HOOK(out_of_memory, TINY_REALLOC, size);
+        }
         return NULL;
     }
+    if(UNLIKELY(is_mapped(ptr))) {
+        size_t old_size = mapping_capacity(mapping_length(ptr));
+        void *data = remap_allocation(ptr, size);
+        store_operation(TINY_REALLOC, data != NULL, size);
+        if(data != NULL) {
+            // Mappings only ever grow with fresh pages
+            tiny.last_zero = true;
+            FIRE_HOOK(realloc, ptr, old_size, data, size);
+        } else {
+            FIRE_HOOK(out_of_memory, TINY_REALLOC, size);
+        }
+        return data;
+    }
 
     size_t blocks_required = ALIGN_SIZE(size) / ALIGNMENT;
     tiny_block *header = (tiny_block *)ptr - HEADER_BLOCKS;
@@ -386,37 +3500,221 @@ void *tiny_realloc(void *ptr, size_t size) {
     tiny_block *next = next_section(header);
     tiny_block_section next_section = read_header(next);
 
-    if(!next_section.taken && next_section.size >= blocks_required - section.size + HEADER_BLOCKS) {
-        write_header(header, section.size + next_section.size + HEADER_BLOCKS, true);
-        allocate_at(read_header(header), blocks_required);
+    if(
+        !next_section.taken && 
+        next_section.size >= blocks_required - section.size + HEADER_BLOCKS &&
+        (tiny.reserved == NULL || commit_section(
+            header, section.size + next_section.size + HEADER_BLOCKS, blocks_required
+        ))
+    ) {
+        write_header(header, section.size + next_section.size + HEADER_BLOCKS, true, section.tag);
+        uncount_section(section.size, true, section.tag);
+        uncount_section(next_section.size, false, 0);
+        count_section(section.size + next_section.size + HEADER_BLOCKS, true, section.tag);
+        FIRE_HOOK(merge, header, next, section.size + next_section.size + HEADER_BLOCKS);
+        allocate_at(read_header(header), blocks_required, section.tag);
+        if(tiny.counters.largest_stale) {
+            tiny.counters.largest_free = largest_free_from(&tiny.buffer[0]);
+            tiny.counters.largest_stale = false;
+        }
         store_operation(TINY_REALLOC, true, size);
+        FIRE_HOOK(realloc, ptr, section.size * ALIGNMENT, ptr, size);
         return  ptr;
     } else {
-        void *new_block = tiny_malloc(size);
+        void *new_block = tiny_malloc_tagged(size, section.tag);
         if(new_block) {
-            memcpy(new_block, section.data, section.size * ALIGNMENT);
+            size_t old_size = section.size * ALIGNMENT;
+            // The new section holds whole blocks too
+            copy_blocks(new_block, section.data, old_size < size ? old_size : ALIGN_SIZE(size));
+            if(UNLIKELY(tiny.stamps != NULL)) {
+                // The moved section keeps its original stamp
+                size_t index = header - tiny.buffer;
+                size_t new_index = (tiny_block *)new_block - HEADER_BLOCKS - tiny.buffer;
+                if(index < tiny.stamp_count && new_index < tiny.stamp_count) {
+                    tiny.stamps[new_index] = tiny.stamps[index];
+                    tiny.stamps[index] = UNSTAMPED;
+                }
+            }
             tiny_free(ptr);
+            FIRE_HOOK(realloc, ptr, section.size * ALIGNMENT, new_block, size);
         }
         store_operation(TINY_REALLOC, new_block != NULL, size);
         return new_block;
     }
 }
 
+// Allocates memory at an address that is a multiple of `alignment`, a power of
+// two. A free section is split so that the data of its second part is aligned;
+// the first part stays free. Such allocations never get their own mapping.
+void *tiny_aligned_alloc(size_t alignment, size_t size) {
+    if(alignment <= ALIGNMENT && alignment != 0 && (alignment & (alignment - 1)) == 0) {
+        return tiny_malloc(size);
+    }
+    if(UNLIKELY(tiny_node_count > 1) && numa_countdown-- == 0) {
+        route_thread();
+    }
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        void *data = NULL;
+        if(lock_shared()) {
+            data = tiny_aligned_alloc(alignment, size);
+            unlock_shared();
+        } else {
+            store_operation(TINY_MALLOC, false, size);
+        }
+        return data;
+    }
+    size_t aligned_size = ALIGN_SIZE(size);
+    bool no_heap = tiny.buffer == NULL && !tiny.growable;
+    if(size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        store_operation(TINY_MALLOC, false, size);
+        return NULL;
+    }
+    if(tiny.out_of_memory || no_heap || aligned_size < size || aligned_size + alignment < aligned_size) {
+        store_operation(TINY_MALLOC, false, size);
+        FIRE_HOOK(out_of_memory, TINY_MALLOC, size);
+        return NULL;
+    }
+
+    unsigned tag = current_tag;
+    size_t blocks_required = aligned_size / ALIGNMENT;
+    tiny_block *header = tiny.buffer;
+    tiny_block_section section = { 0 };
+    if(header != NULL) {
+        section = read_header(header);
+    }
+    while(section.size > 0) {
+        if(section.taken) {
+            header = next_section(header);
+            section = read_header(header);
+            continue;
+        }
+        // The part before the aligned data must hold a free section
+        uintptr_t data = (uintptr_t)section.data;
+        uintptr_t aligned = (data + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if(aligned != data && aligned - data < (HEADER_BLOCKS + 1) * ALIGNMENT) {
+            aligned += alignment;
+        }
+        size_t lead = (aligned - data) / ALIGNMENT;
+        if(section.size < lead || section.size - lead < blocks_required) {
+            header = next_section(header);
+            section = read_header(header);
+            continue;
+        }
+        if(lead != 0) {
+            tiny_block *rest = (tiny_block *)aligned - HEADER_BLOCKS;
+            size_t rest_size = section.size - lead;
+            if(UNLIKELY(tiny.reserved != NULL) && !commit_section(rest, rest_size, blocks_required)) {
+                break;
+            }
+            uncount_section(section.size, false, 0);
+            write_header(header, lead - HEADER_BLOCKS, false, 0);
+            write_header(rest, rest_size, false, 0);
+            count_section(lead - HEADER_BLOCKS, false, 0);
+            count_section(rest_size, false, 0);
+            if(UNLIKELY(tiny.decay != 0)) {
+                write_stamp(rest, read_stamp(header));
+            }
+            FIRE_HOOK(split, header, lead - HEADER_BLOCKS, rest, rest_size);
+            header = rest;
+            section = read_header(header);
+        }
+        if(!allocate_at(section, blocks_required, tag)) {
+            break;
+        }
+        tiny.counters.tags[tag].allocations++;
+        if(tiny.counters.largest_stale) {
+            tiny.counters.largest_free = largest_free_from(&tiny.buffer[0]);
+            tiny.counters.largest_stale = false;
+        }
+        if(UNLIKELY(tiny.stamps != NULL)) {
+            stamp_section(header);
+        }
+        store_operation(TINY_MALLOC, true, size);
+        FIRE_HOOK(allocate, section.data, size);
+        return section.data;
+    }
+    // Grows by enough for the data to be aligned with a free section before it
+    if(section.size == 0 && grow_heap(blocks_required + (alignment / ALIGNMENT) + 2 * HEADER_BLOCKS)) {
+        return tiny_aligned_alloc(alignment, size);
+    }
+    store_operation(TINY_MALLOC, false, size);
+    FIRE_HOOK(out_of_memory, TINY_MALLOC, size);
+    return NULL;
+}
+
 void *tiny_calloc(size_t num, size_t size) {
     size_t full_size = num * size;
     if(size == 0 || num == 0 || full_size / num != size) {
         store_operation(TINY_CALLOC, false, size);
+        if(size != 0 && num != 0) {
+            FIRE_HOOK(out_of_memory, TINY_CALLOC, size);
+        }
         return NULL;
     }
+    tiny.last_zero = false;
     void *data = tiny_malloc(full_size);
     if(data != NULL) {
-        memset(data, 0, full_size);
+        // The whole section is cleared, so that `tiny_recalloc()` can rely on
+        // it, but only the first block of one known to be zeroed
+        size_t clear = tiny_usable_size(data);
+        zero_blocks(data, tiny.last_zero && clear > ALIGNMENT ? ALIGNMENT : clear, false);
     }
     store_operation(TINY_CALLOC, data != NULL, num * size);
     return data;
 }
 
+// Reallocates memory to hold `num` objects of `size` bytes, zeroing whatever
+// lies past the usable size it had. Unless it is moved to memory known to be
+// zeroed, only that tail is cleared.
+void *tiny_recalloc(void *ptr, size_t num, size_t size) {
+    if(ptr == NULL) {
+        return tiny_calloc(num, size);
+    }
+    size_t full_size = num * size;
+    if(size == 0 || num == 0 || full_size / num != size) {
+        store_operation(TINY_REALLOC, false, size);
+        if(size != 0 && num != 0) {
+            FIRE_HOOK(out_of_memory, TINY_REALLOC, size);
+        }
+        return NULL;
+    }
+    size_t old_size = tiny_usable_size(ptr);
+    tiny.last_zero = false;
+    unsigned char *data = tiny_realloc(ptr, full_size);
+    if(data != NULL && !tiny.last_zero) {
+        size_t new_size = tiny_usable_size(data);
+        if(new_size > old_size) {
+            zero_blocks(data + old_size, new_size - old_size, false);
+        }
+    }
+    return data;
+}
+
 void tiny_free(void *ptr) {
+    if(UNLIKELY(tiny_node_count > 1) && ptr != NULL && owner_of(ptr) != tiny_heap) {
+        // Memory goes back to the heap it was taken from
+        struct tiny_context *previous = tiny_heap;
+        tiny_heap = owner_of(ptr);
+        tiny_free(ptr);
+        tiny_heap = previous;
+        return;
+    }
+    if(UNLIKELY(tiny.shared != NULL) && !shared_held) {
+        if(lock_shared()) {
+            tiny_free(ptr);
+            unlock_shared();
+        } else {
+            store_operation(TINY_FREE, false, 0);
+        }
+        return;
+    }
+    if(ptr != NULL && UNLIKELY(is_mapped(ptr))) {
+        size_t size = mapping_capacity(mapping_length(ptr));
+        FIRE_HOOK(free, ptr, size);
+        unmap_allocation(ptr);
+        store_operation(TINY_FREE, true, size / ALIGNMENT);
+        return;
+    }
     if(ptr == NULL || tiny.buffer == NULL) {
         store_operation(TINY_FREE, false, 0);
         return;
@@ -424,23 +3722,28 @@ void tiny_free(void *ptr) {
 
     tiny_block *current = (tiny_block *)ptr - HEADER_BLOCKS;
     tiny_block_section current_section = read_header(current);
-    write_header(current, current_section.size, false);
-
-    tiny_block *header = &tiny.buffer[0];
-    tiny_block_section section = read_header(header);
-    while(section.size > 0) {
-        tiny_block *next = next_section(header);
-        if(!section.taken) {
-            tiny_block_section next_section = read_header(next);
-            if(!next_section.taken) {
-                write_header(header, section.size + next_section.size + HEADER_BLOCKS, false);
-                section = read_header(header);
-                continue;
-            }
-        }
+    write_header(current, current_section.size, false, 0);
+    uint32_t now = 0;
+    if(UNLIKELY(tiny.decay != 0)) {
+        now = clock_ms();
+        write_stamp(current, now);
+    }
+    if(UNLIKELY(tiny.stamps != NULL)) {
+        record_lifetime(current, current_section.size);
+    }
+    uncount_section(current_section.size, true, current_section.tag);
+    count_section(current_section.size, false, 0);
+    FIRE_HOOK(free, ptr, current_section.size * ALIGNMENT);
 
-        header = next;
-        section = read_header(header);
-    } 
+    tiny_block *reserved_tail = merge_free_sections();
+    if(UNLIKELY(reserved_tail != NULL)) {
+        decommit_from(reserved_tail);
+    }
+    if(UNLIKELY(tiny.trim_threshold != 0)) {
+        trim_tail();
+    }
+    if(UNLIKELY(tiny.decay != 0) && ((now - tiny.decay_clock) & STAMP_MASK) >= tiny.decay) {
+        purge_free_sections(true, now, 0);
+    }
     store_operation(TINY_FREE, true, current_section.size);
 }
@@ -3,18 +3,25 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum tiny_function {
+    TINY_LOAD,
+    TINY_INIT,
+    TINY_CLEAR,
+    TINY_RESET,
+    TINY_MALLOC,
+    TINY_REALLOC,
+    TINY_CALLOC,
+    TINY_FREE
+};
 
 typedef struct tiny_operation {
-    enum tiny_function {
-        TINY_LOAD,
-        TINY_INIT,
-        TINY_CLEAR,
-        TINY_RESET,
-        TINY_MALLOC,
-        TINY_REALLOC,
-        TINY_CALLOC,
-        TINY_FREE
-    } function;
+    enum tiny_function function;
     bool success;
     size_t size;
 } tiny_operation;
@@ -24,6 +31,20 @@ typedef struct tiny_size {
     size_t bytes;
 } tiny_size;
 
+typedef struct tiny_sections {
+    size_t total;
+    size_t free;
+    size_t taken;
+} tiny_sections;
+
+enum { TINY_TAGS = 16 };
+
+typedef struct tiny_tag_stats {
+    tiny_size live;
+    tiny_size peak;
+    size_t allocations;
+} tiny_tag_stats;
+
 typedef struct tiny_summary {
     size_t alignment;
     char *aligned_type;
@@ -34,11 +55,9 @@ typedef struct tiny_summary {
     tiny_size total;
     tiny_size free;
     tiny_size taken;
-    struct tiny_sections {
-        size_t total;
-        size_t free;
-        size_t taken;
-    } sections;
+    tiny_sections sections;
+    tiny_tag_stats tags[TINY_TAGS];
+    size_t page_size;
 } tiny_summary;
 
 typedef struct tiny_section {
@@ -46,20 +65,196 @@ typedef struct tiny_section {
     void *header;
     void *data;
     tiny_size size;
+    unsigned tag;
 } tiny_section;
 
+typedef struct tiny_stats {
+    tiny_size free;
+    tiny_size taken;
+    tiny_size peak;
+    tiny_size largest_free;
+    tiny_sections sections;
+    size_t operations[TINY_FREE + 1];
+    size_t failures;
+    tiny_size mapped;
+    size_t mappings;
+} tiny_stats;
+
+enum { 
+    TINY_LIFETIME_SIZES = 16,
+    TINY_LIFETIME_BUCKETS = 24
+};
+
+typedef struct tiny_lifetime_size {
+    size_t freed;
+    uint64_t total_lifetime;
+    size_t histogram[TINY_LIFETIME_BUCKETS];
+} tiny_lifetime_size;
+
+typedef struct tiny_lifetimes {
+    uint64_t epoch;
+    tiny_lifetime_size sizes[TINY_LIFETIME_SIZES];
+} tiny_lifetimes;
+
+#define TINY_STATS_MAGIC 0x796e6974u
+#define TINY_STATS_VERSION 2u
+
+typedef struct tiny_stats_page {
+    unsigned magic;
+    unsigned version;
+    long pid;
+    volatile size_t sequence;
+    tiny_stats stats;
+} tiny_stats_page;
+
+#define TINY_SNAPSHOT_MAGIC "tinysnap"
+#define TINY_SNAPSHOT_VERSION 1u
+#define TINY_SNAPSHOT_TAKEN 1u
+
+typedef struct tiny_snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t alignment;
+    uint32_t header_blocks;
+    uint32_t last_function;
+    uint32_t last_success;
+    uint32_t reserved;
+    uint64_t last_size;
+    uint64_t buffer;
+    uint64_t total_blocks;
+    uint64_t section_count;
+} tiny_snapshot_header;
+
+typedef struct tiny_snapshot_record {
+    uint64_t offset;
+    uint64_t blocks;
+    uint32_t flags;
+    uint32_t tag;
+} tiny_snapshot_record;
+
+typedef struct tiny_growth {
+    void *context;
+    void *(*grow)(void *context, void *hint, size_t size);
+    void (*release)(void *context, void *chunk, size_t size);
+    size_t increment;
+} tiny_growth;
+
+typedef struct tiny_hooks {
+    void *context;
+    void (*allocate)(void *context, void *ptr, size_t size);
+    void (*free)(void *context, void *ptr, size_t size);
+    void (*realloc)(void *context, void *old_ptr, size_t old_size, void *new_ptr, size_t size);
+    void (*split)(void *context, void *header, size_t blocks, void *remainder, size_t remainder_blocks);
+    void (*merge)(void *context, void *header, void *absorbed, size_t blocks);
+    void (*out_of_memory)(void *context, enum tiny_function function, size_t size);
+} tiny_hooks;
+
+typedef void (*tiny_sink)(void *context, const char *data, size_t length);
+
+typedef struct tiny_context tiny_context;
+
+typedef enum tiny_dump_format {
+    TINY_TEXT,
+    TINY_JSON
+} tiny_dump_format;
+
+enum tiny_dump_flags {
+    TINY_DUMP_SUMMARY = 1 << 0,
+    TINY_DUMP_LAST_OP = 1 << 1,
+    TINY_DUMP_HEAP = 1 << 2,
+    TINY_DUMP_LIFETIMES = 1 << 3,
+    TINY_DUMP_ALL = 
+        TINY_DUMP_SUMMARY | TINY_DUMP_LAST_OP | TINY_DUMP_HEAP | TINY_DUMP_LIFETIMES
+};
+
+enum tiny_map_flags {
+    TINY_MAP_HUGETLB = 1 << 0,
+    TINY_MAP_HUGEPAGE = 1 << 1,
+    TINY_MAP_POPULATE = 1 << 2,
+    TINY_MAP_LOCK = 1 << 3
+};
+
 void tiny_init(unsigned char *buffer, size_t size);
+bool tiny_init_reserved(size_t max_size);
+bool tiny_init_mapped(size_t size, unsigned flags);
+bool tiny_init_numa(size_t size, unsigned flags);
+void tiny_set_numa_routing(bool enabled);
+unsigned tiny_numa_nodes(void);
+bool tiny_open_file(const char *path, size_t size);
+bool tiny_open_shared(const char *name, size_t size);
+uint64_t tiny_ptr_to_off(const void *ptr);
+void *tiny_off_to_ptr(uint64_t offset);
+void tiny_set_root(void *ptr);
+void *tiny_root(void);
+tiny_context *tiny_create(unsigned char *buffer, size_t size);
+tiny_context *tiny_use(tiny_context *context);
 void tiny_clear(void);
 void tiny_reset(void);
 void tiny_out_of_memory(bool status);
 tiny_operation tiny_last_operation(void);
 size_t tiny_block_size(void);
 void tiny_print(bool summary, bool last_op, bool heap);
+void tiny_dump(tiny_sink sink, void *context, unsigned flags, tiny_dump_format format);
 tiny_summary tiny_inspect(void);
 tiny_section tiny_next_section(void *previous_header);
+void tiny_set_hooks(const tiny_hooks *hooks);
+void tiny_set_growth(const tiny_growth *growth);
+size_t tiny_shrink(void);
+size_t tiny_trim(size_t pad);
+void tiny_set_trim_threshold(size_t threshold, size_t pad);
+bool tiny_set_decay(uint32_t decay_ms);
+size_t tiny_purge(void);
+size_t tiny_prezero(size_t limit);
+size_t tiny_prefault(size_t size);
+void tiny_set_mmap_threshold(size_t threshold);
+void tiny_set_stream_threshold(size_t threshold);
+tiny_stats tiny_statistics(void);
+bool tiny_publish(const char *name);
+bool tiny_snapshot(int fd);
+bool tiny_profile_lifetimes(uint64_t *stamps, size_t count);
+tiny_lifetimes tiny_inspect_lifetimes(void);
 void *tiny_malloc(size_t size);
+void *tiny_malloc_tagged(size_t size, unsigned tag);
+void *tiny_malloc_blocks(size_t blocks, size_t size);
+unsigned tiny_tag_scope(unsigned tag);
+tiny_tag_stats tiny_inspect_tag(unsigned tag);
 void *tiny_realloc(void *ptr, size_t size);
 void *tiny_calloc(size_t num, size_t size);
+void *tiny_recalloc(void *ptr, size_t num, size_t size);
+void *tiny_aligned_alloc(size_t alignment, size_t size);
 void tiny_free(void *ptr);
+void tiny_free_sized(void *ptr, size_t size);
+bool tiny_owns(const void *ptr);
+size_t tiny_usable_size(void *ptr);
+
+#if defined(TINY_INLINE) && (defined(__GNUC__) || defined(__clang__))
+// Rounds constant sizes of up to TINY_INLINE_MAX bytes to blocks at compile
+// time and takes them with `tiny_malloc_blocks()`. Only the rounding is saved:
+// the request is still checked and the heap walked by a call. Enabled by the
+// single-header build.
+#ifndef TINY_INLINE_MAX
+#define TINY_INLINE_MAX 4096
+#endif
+
+#ifdef TINY_ALIGNMENT
+struct tiny_block_align { char c; TINY_ALIGNMENT align; };
+#else
+struct tiny_block_align { char c; max_align_t align; };
+#endif
+#define TINY_BLOCK_SIZE offsetof(struct tiny_block_align, align)
+
+__attribute__((always_inline))
+static inline void *tiny_malloc_inline(size_t size) {
+    if(__builtin_constant_p(size) && size != 0 && size <= TINY_INLINE_MAX) {
+        return tiny_malloc_blocks((size + TINY_BLOCK_SIZE - 1) / TINY_BLOCK_SIZE, size);
+    }
+    return (tiny_malloc)(size);
+}
+#define tiny_malloc(size) tiny_malloc_inline(size)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* end of guard: TINY_H */
\ No newline at end of file
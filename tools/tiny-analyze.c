@@ -0,0 +1,277 @@
+#include "tiny.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Analyses heap snapshots written by `tiny_snapshot()`.
+//
+// Usage:
+//     tiny-analyze SNAPSHOT                 Reports layout and fragmentation
+//     tiny-analyze SNAPSHOT fit SIZE...     Reports whether SIZE bytes would fit
+//     tiny-analyze diff OLD NEW             Reports where the heap grew
+
+// Width of the fragmentation map, in characters
+enum { MAP_WIDTH = 64 };
+
+// How many power-of-two size buckets are reported
+enum { BUCKETS = 48 };
+
+typedef struct snapshot {
+    tiny_snapshot_header header;
+    tiny_snapshot_record *records;
+} snapshot;
+
+static bool load_snapshot(const char *path, snapshot *snap) {
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    bool loaded = false;
+    snap->records = NULL;
+    if(fread(&snap->header, sizeof(snap->header), 1, file) != 1 ||
+       memcmp(snap->header.magic, TINY_SNAPSHOT_MAGIC, sizeof(snap->header.magic)) != 0) {
+        fprintf(stderr, "%s: not a tiny snapshot\n", path);
+    } else if(snap->header.version != TINY_SNAPSHOT_VERSION) {
+        fprintf(stderr, "%s: unsupported snapshot version %u\n", path, snap->header.version);
+    } else {
+        size_t count = snap->header.section_count;
+        snap->records = calloc(count ? count : 1, sizeof(tiny_snapshot_record));
+        if(snap->records && fread(snap->records, sizeof(tiny_snapshot_record), count, file) == count) {
+            loaded = true;
+        } else {
+            fprintf(stderr, "%s: truncated snapshot\n", path);
+        }
+    }
+    fclose(file);
+    return loaded;
+}
+
+static bool is_taken(const tiny_snapshot_record *record) {
+    return record->flags & TINY_SNAPSHOT_TAKEN;
+}
+
+static size_t bytes(const snapshot *snap, uint64_t blocks) {
+    return blocks * snap->header.alignment;
+}
+
+// Returns the index of the power-of-two bucket that holds a size
+static size_t bucket_of(uint64_t value) {
+    size_t bucket = 0;
+    while(value > 1 && bucket < BUCKETS - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Returns the first block covered by a column of the fragmentation map
+static uint64_t column_start(size_t column, uint64_t total) {
+    return (column * total + MAP_WIDTH - 1) / MAP_WIDTH;
+}
+
+// Prints the heap as a row of characters, each covering a slice of blocks:
+// '#' when fully taken, '.' when fully free and '+' when mixed
+static void print_map(const snapshot *snap) {
+    uint64_t total = snap->header.total_blocks + snap->header.header_blocks;
+    uint64_t taken[MAP_WIDTH] = { 0 }, covered[MAP_WIDTH] = { 0 };
+    for(uint64_t i = 0; i < snap->header.section_count; i++) {
+        const tiny_snapshot_record *record = &snap->records[i];
+        uint64_t start = record->offset;
+        uint64_t end = start + record->blocks + snap->header.header_blocks;
+        for(size_t column = start * MAP_WIDTH / total; column < MAP_WIDTH; column++) {
+            uint64_t low = column_start(column, total), high = column_start(column + 1, total);
+            low = low > start ? low : start;
+            high = high < end ? high : end;
+            if(low >= high) {
+                break;
+            }
+            covered[column] += high - low;
+            if(is_taken(record)) {
+                taken[column] += high - low;
+            }
+        }
+    }
+
+    printf("Map: [");
+    for(size_t column = 0; column < MAP_WIDTH; column++) {
+        putchar(
+            taken[column] == 0 ? '.' :
+            taken[column] == covered[column] ? '#' : '+'
+        );
+    }
+    printf("]\n");
+}
+
+static void report(const snapshot *snap) {
+    static const char * const operations[] = {
+        "load", "init", "clear", "reset", "malloc", "realloc", "calloc", "free"
+    };
+    const tiny_snapshot_header *header = &snap->header;
+    uint64_t free_blocks = 0, taken_blocks = 0, largest = 0, free_sections = 0;
+    uint64_t histogram[BUCKETS] = { 0 };
+    for(uint64_t i = 0; i < header->section_count; i++) {
+        const tiny_snapshot_record *record = &snap->records[i];
+        if(is_taken(record)) {
+            taken_blocks += record->blocks;
+        } else {
+            free_sections++;
+            free_blocks += record->blocks;
+            histogram[bucket_of(bytes(snap, record->blocks))]++;
+            if(record->blocks > largest) {
+                largest = record->blocks;
+            }
+        }
+    }
+
+    printf(
+        "Buffer: [0x%llx], %zu bytes, alignment %u\n"
+        "Last operation: %s of %llu bytes (%s)\n"
+        "Sections: %llu in total, %llu free, %llu taken\n"
+        "Taken: %zu bytes\n"
+        "Free: %zu bytes\n"
+        "Largest free section: %zu bytes\n"
+        "Fragmentation: %.1f%%\n",
+        (unsigned long long)header->buffer, bytes(snap, header->total_blocks), header->alignment,
+        header->last_function < sizeof(operations) / sizeof(operations[0]) ?
+            operations[header->last_function] : "unknown",
+        (unsigned long long)header->last_size,
+        header->last_success ? "success" : "failure",
+        (unsigned long long)header->section_count,
+        (unsigned long long)free_sections,
+        (unsigned long long)(header->section_count - free_sections),
+        bytes(snap, taken_blocks),
+        bytes(snap, free_blocks),
+        bytes(snap, largest),
+        free_blocks ? 100.0 * (1.0 - (double)largest / (double)free_blocks) : 0.0
+    );
+    print_map(snap);
+
+    printf("\nFree section sizes:\n");
+    for(size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        if(histogram[bucket]) {
+            printf(
+                "  %12zu - %12zu bytes: %llu\n",
+                (size_t)1 << bucket, ((size_t)2 << bucket) - 1,
+                (unsigned long long)histogram[bucket]
+            );
+        }
+    }
+}
+
+// Answers whether a request of some size would fit, and how many of them
+// the free sections could hold if allocated one after another
+static void fit(const snapshot *snap, size_t size) {
+    uint64_t alignment = snap->header.alignment;
+    uint64_t blocks = (size + alignment - 1) / alignment;
+    uint64_t header_blocks = snap->header.header_blocks;
+    uint64_t count = 0;
+    const tiny_snapshot_record *first = NULL;
+    for(uint64_t i = 0; i < snap->header.section_count; i++) {
+        const tiny_snapshot_record *record = &snap->records[i];
+        if(!is_taken(record) && record->blocks >= blocks) {
+            if(first == NULL) {
+                first = record;
+            }
+            count += (record->blocks + header_blocks) / (blocks + header_blocks);
+        }
+    }
+    if(first) {
+        printf(
+            "%zu bytes: fits at offset %zu, %llu would fit in total\n",
+            size, bytes(snap, first->offset), (unsigned long long)count
+        );
+    } else {
+        printf("%zu bytes: does not fit\n", size);
+    }
+}
+
+// Returns whether a taken section of the new snapshot was already taken, with
+// the same size, in the old one
+static bool was_taken(const snapshot *old, const tiny_snapshot_record *record) {
+    size_t low = 0, high = old->header.section_count;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        if(old->records[middle].offset < record->offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < old->header.section_count &&
+        old->records[low].offset == record->offset &&
+        old->records[low].blocks == record->blocks &&
+        is_taken(&old->records[low]);
+}
+
+static void diff(const snapshot *old, const snapshot *new) {
+    uint64_t old_taken = 0, new_taken = 0, grown = 0, grown_blocks = 0;
+    for(uint64_t i = 0; i < old->header.section_count; i++) {
+        if(is_taken(&old->records[i])) {
+            old_taken += old->records[i].blocks;
+        }
+    }
+
+    printf("New taken sections:\n");
+    for(uint64_t i = 0; i < new->header.section_count; i++) {
+        const tiny_snapshot_record *record = &new->records[i];
+        if(!is_taken(record)) {
+            continue;
+        }
+        new_taken += record->blocks;
+        if(!was_taken(old, record)) {
+            grown++;
+            grown_blocks += record->blocks;
+            printf(
+                "  offset %12zu: %12zu bytes (tag %u)\n",
+                bytes(new, record->offset), bytes(new, record->blocks), record->tag
+            );
+        }
+    }
+    printf(
+        "\nSections: %llu -> %llu\n"
+        "Taken: %zu -> %zu bytes\n"
+        "New taken sections: %llu, %zu bytes\n",
+        (unsigned long long)old->header.section_count,
+        (unsigned long long)new->header.section_count,
+        bytes(old, old_taken), bytes(new, new_taken),
+        (unsigned long long)grown, bytes(new, grown_blocks)
+    );
+}
+
+static int usage(const char *program) {
+    fprintf(
+        stderr,
+        "Usage: %s SNAPSHOT\n"
+        "       %s SNAPSHOT fit SIZE...\n"
+        "       %s diff OLD NEW\n",
+        program, program, program
+    );
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    snapshot first, second;
+    if(argc == 4 && strcmp(argv[1], "diff") == 0) {
+        if(!load_snapshot(argv[2], &first) || !load_snapshot(argv[3], &second)) {
+            return EXIT_FAILURE;
+        }
+        diff(&first, &second);
+    } else if(argc == 2) {
+        if(!load_snapshot(argv[1], &first)) {
+            return EXIT_FAILURE;
+        }
+        report(&first);
+    } else if(argc > 3 && strcmp(argv[2], "fit") == 0) {
+        if(!load_snapshot(argv[1], &first)) {
+            return EXIT_FAILURE;
+        }
+        for(int i = 3; i < argc; i++) {
+            fit(&first, strtoull(argv[i], NULL, 10));
+        }
+    } else {
+        return usage(argv[0]);
+    }
+    return EXIT_SUCCESS;
+}
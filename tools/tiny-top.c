@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tiny.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Displays the statistics published by a process through `tiny_publish()`.
+//
+// Usage: tiny-top NAME [INTERVAL_MS [ITERATIONS]]
+
+static const char * const operations[] = {
+    "load",
+    "init",
+    "clear",
+    "reset",
+    "malloc",
+    "realloc",
+    "calloc",
+    "free"
+};
+
+// Reads a consistent copy of the statistics, retrying while a write is in
+// progress
+static tiny_stats read_stats(const tiny_stats_page *page) {
+    tiny_stats stats;
+    size_t before, after;
+    do {
+        before = page->sequence;
+        atomic_thread_fence(memory_order_acquire);
+        memcpy(&stats, (const void *)&page->stats, sizeof(stats));
+        atomic_thread_fence(memory_order_acquire);
+        after = page->sequence;
+    } while(before != after || (before & 1));
+    return stats;
+}
+
+static void print_stats(const tiny_stats_page *page, const tiny_stats *stats) {
+    size_t total = stats->free.bytes + stats->taken.bytes;
+    printf(
+        "tiny-top - pid %ld\n\n"
+        "Taken:        %12zu bytes (%zu%%)\n"
+        "Free:         %12zu bytes\n"
+        "Peak taken:   %12zu bytes\n"
+        "Largest free: %12zu bytes\n"
+        "Sections:     %12zu (%zu free, %zu taken)\n"
+        "Mapped:       %12zu bytes (%zu mappings)\n\n",
+        page->pid,
+        stats->taken.bytes, total ? stats->taken.bytes * 100 / total : 0,
+        stats->free.bytes,
+        stats->peak.bytes,
+        stats->largest_free.bytes,
+        stats->sections.total, stats->sections.free, stats->sections.taken,
+        stats->mapped.bytes, stats->mappings
+    );
+    for(size_t i = 0; i < sizeof(operations) / sizeof(operations[0]); i++) {
+        printf("%-8s %12zu\n", operations[i], stats->operations[i]);
+    }
+    printf("%-8s %12zu\n", "failures", stats->failures);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fprintf(stderr, "Usage: %s NAME [INTERVAL_MS [ITERATIONS]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    long interval = argc > 2 ? strtol(argv[2], NULL, 10) : 1000;
+    long iterations = argc > 3 ? strtol(argv[3], NULL, 10) : 0;
+
+    int fd = shm_open(argv[1], O_RDONLY, 0);
+    if(fd < 0) {
+        perror("shm_open");
+        return EXIT_FAILURE;
+    }
+    const tiny_stats_page *page = mmap(
+        NULL, sizeof(tiny_stats_page), PROT_READ, MAP_SHARED, fd, 0
+    );
+    close(fd);
+    if(page == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    if(page->magic != TINY_STATS_MAGIC || page->version != TINY_STATS_VERSION) {
+        fprintf(stderr, "%s: not a tiny statistics page\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec delay = { interval / 1000, (interval % 1000) * 1000000 };
+    for(long i = 0; iterations == 0 || i < iterations; i++) {
+        tiny_stats stats = read_stats(page);
+        if(iterations != 1) {
+            printf("\033[H\033[J");
+        }
+        print_stats(page, &stats);
+        fflush(stdout);
+        if(iterations == 0 || i + 1 < iterations) {
+            nanosleep(&delay, NULL);
+        }
+    }
+    return EXIT_SUCCESS;
+}